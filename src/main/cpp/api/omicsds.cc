@@ -57,16 +57,26 @@ class FeatureProcessor {
   FeatureProcessor(std::vector<std::string>& features, feature_process_fn_t proc)
       : m_features(features), m_process_all_features(!features.size()), m_proc(proc) {}
 
-  void process(const std::array<uint64_t, 3>& coords, const std::vector<OmicsFieldData>& data) {
-    auto& row_id = coords[0];
-    auto gtf_id = decode_gtf_id({coords[1], coords[2]});
-    if (m_process_all_features ||
-        std::find(m_features.begin(), m_features.end(), gtf_id) != m_features.end()) {
-      float score = data[0].get<float>();
+  // the score is the only attribute of feature arrays
+  void process(OmicsColumns& columns) {
+    auto scores = static_cast<const float*>(columns.values[0]);
+    for (size_t cell = 0; cell < columns.cells; cell++) {
+      // cells of a feature are mostly adjacent, its id is decoded once for them
+      gtf_encoding_t feature = {columns.positions[cell], columns.levels[cell]};
+      if (feature != m_last_feature) {
+        m_last_feature = feature;
+        last_feature_processed = decode_gtf_id(feature);
+        m_selected = m_process_all_features ||
+                     std::find(m_features.begin(), m_features.end(), last_feature_processed) !=
+                         m_features.end();
+      }
+      if (!m_selected) continue;
+      auto& row_id = columns.samples[cell];
       if (m_proc) {
-        m_proc(gtf_id, row_id, score);
+        m_proc(last_feature_processed, row_id, scores[cell]);
       } else {
-        logger.info("Feature id={}, Sample id={}, Score={}", gtf_id, row_id, score);
+        logger.info("Feature id={}, Sample id={}, Score={}", last_feature_processed, row_id,
+                    scores[cell]);
       }
     }
   }
@@ -77,6 +87,8 @@ class FeatureProcessor {
   feature_process_fn_t m_proc;
 
   std::string last_feature_processed;
+  gtf_encoding_t m_last_feature = {std::numeric_limits<uint64_t>::max(), 0};
+  bool m_selected = false;
 };
 
 void OmicsDS::query_features(OmicsDSHandle handle, std::vector<std::string>& features,
@@ -89,18 +101,18 @@ void OmicsDS::query_features(OmicsDSHandle handle, std::vector<std::string>& fea
   logger.debug("New Query for sample range = {}-{}", sample_range[0], sample_range[1]);
 
   FeatureProcessor feature_processor(features, proc);
-  process_function bound = std::bind(&FeatureProcessor::process, std::ref(feature_processor),
-                                     std::placeholders::_1, std::placeholders::_2);
+  process_batch_t bound =
+      std::bind(&FeatureProcessor::process, std::ref(feature_processor), std::placeholders::_1);
   if (features.size() == 0) {
     std::array<int64_t, 2> range = {0, std::numeric_limits<int64_t>::max()};
-    instance->query(sample_range, range, bound);
+    instance->query_batches(bound, sample_range, range);
   } else {
     std::array<int64_t, 2> range = {0, 0};
     for (auto feature : features) {
       auto gtf_id = encode_gtf_id(feature);
       range[0] = gtf_id.first;
       range[1] = gtf_id.first;
-      instance->query(sample_range, range, bound);
+      instance->query_batches(bound, sample_range, range);
     }
   }
 }
@@ -63,6 +63,50 @@ void OmicsDSConfigure::update_import_config(const OmicsDSImportConfig& config) {
   if (config.sample_major) {
     import_config->set_sample_major(config.sample_major);
   }
+
+  if (config.parse_threads) {
+    import_config->set_parse_threads(*config.parse_threads);
+  }
+
+  if (config.write_buffer_sets) {
+    import_config->set_write_buffer_sets(*config.write_buffer_sets);
+  }
+
+  if (config.memory_budget) {
+    import_config->set_memory_budget(*config.memory_budget);
+  }
+
+  if (config.shards) {
+    import_config->set_shards(*config.shards);
+  }
+
+  if (config.sort_input) {
+    import_config->set_sort_input(config.sort_input);
+  }
+
+  if (config.max_open_files) {
+    import_config->set_max_open_files(*config.max_open_files);
+  }
+
+  if (config.merge_fan_in) {
+    import_config->set_merge_fan_in(*config.merge_fan_in);
+  }
+
+  if (config.presorted_files) {
+    import_config->set_presorted_files(config.presorted_files);
+  }
+
+  if (config.decompression_threads) {
+    import_config->set_decompression_threads(*config.decompression_threads);
+  }
+
+  if (config.dense) {
+    import_config->set_dense(config.dense);
+  }
+
+  if (config.compression) {
+    import_config->set_compression(*config.compression);
+  }
 }
 
 OmicsDSImportConfig OmicsDSConfigure::get_import_config() {
@@ -99,6 +143,46 @@ OmicsDSImportConfig OmicsDSConfigure::get_import_config() {
   if (internal_import_config->has_sample_major()) {
     import_config.sample_major = internal_import_config->sample_major();
   }
+  if (internal_import_config->has_parse_threads()) {
+    import_config.parse_threads =
+        std::make_optional<uint32_t>(internal_import_config->parse_threads());
+  }
+  if (internal_import_config->has_write_buffer_sets()) {
+    import_config.write_buffer_sets =
+        std::make_optional<uint32_t>(internal_import_config->write_buffer_sets());
+  }
+  if (internal_import_config->has_memory_budget()) {
+    import_config.memory_budget =
+        std::make_optional<uint64_t>(internal_import_config->memory_budget());
+  }
+  if (internal_import_config->has_shards()) {
+    import_config.shards = std::make_optional<uint32_t>(internal_import_config->shards());
+  }
+  if (internal_import_config->has_sort_input()) {
+    import_config.sort_input = internal_import_config->sort_input();
+  }
+  if (internal_import_config->has_max_open_files()) {
+    import_config.max_open_files =
+        std::make_optional<uint32_t>(internal_import_config->max_open_files());
+  }
+  if (internal_import_config->has_merge_fan_in()) {
+    import_config.merge_fan_in =
+        std::make_optional<uint32_t>(internal_import_config->merge_fan_in());
+  }
+  if (internal_import_config->has_presorted_files()) {
+    import_config.presorted_files = internal_import_config->presorted_files();
+  }
+  if (internal_import_config->has_decompression_threads()) {
+    import_config.decompression_threads =
+        std::make_optional<uint32_t>(internal_import_config->decompression_threads());
+  }
+  if (internal_import_config->has_dense()) {
+    import_config.dense = internal_import_config->dense();
+  }
+  if (internal_import_config->has_compression()) {
+    import_config.compression =
+        std::make_optional<std::string>(internal_import_config->compression());
+  }
 
   return import_config;
 }
@@ -26,9 +26,13 @@
  */
 
 #include "omicsds_export.h"
+#include "omicsds_array_metadata.pb.h"
 
+#include <cmath>
+#include <cstring>
 #include <fstream>
 #include <iostream>
+#include <set>
 #include <sstream>
 #include <string>
 
@@ -56,14 +60,130 @@ std::pair<std::vector<void*>, std::vector<size_t>> OmicsExporter::prepare_buffer
 
 void OmicsExporter::query(std::array<int64_t, 2> sample_range,
                           std::array<int64_t, 2> position_range, process_function proc) {
+  process_function process = proc ? proc
+                                  : std::bind(&OmicsExporter::process, this, std::placeholders::_1,
+                                              std::placeholders::_2);
+  auto span = m_schema->slot<int64_t>("SPAN");
+  if (!span.valid()) {
+    retrieve(sample_range, position_range, process);
+    return;
+  }
+
+  // the end cells of reads and intervals only mark where they end, their fields are with the cell
+  // at their start. Rows whose end cells in range start before it are queried again for the starts
+  std::set<int64_t> rows;
+  int64_t first_start = position_range[0];
+  retrieve(sample_range, position_range,
+           [&](const std::array<uint64_t, 3>& coords, const std::vector<OmicsFieldData>& data) {
+             int64_t start = span.get(data, 0);
+             if ((int64_t)coords[1] == start) {
+               process(coords, data);
+             } else if (start < position_range[0]) {
+               rows.insert(coords[0]);
+               first_start = std::min(first_start, start);
+             }
+           });
+  if (rows.empty()) return;
+
+  retrieve({*rows.begin(), *rows.rbegin()}, {first_start, position_range[0] - 1},
+           [&](const std::array<uint64_t, 3>& coords, const std::vector<OmicsFieldData>& data) {
+             if ((int64_t)coords[1] == span.get(data, 0) &&
+                 span.get(data, 1) >= position_range[0] && rows.count(coords[0])) {
+               process(coords, data);
+             }
+           });
+}
+
+void OmicsExporter::load_dense_features(const std::string& metadata_path) {
+  if (!FileUtility::is_file(metadata_path)) return;
+  OmicsDSArrayMetadata metadata(metadata_path);
+  if (!metadata.is_dense()) return;
+
+  m_dense = true;
+  m_dense_features = metadata.dense_features();
+  for (auto i = 0ul; i < m_dense_features.size(); i++) {
+    m_dense_ids.emplace_back(m_dense_features[i].first, i);
+  }
+  std::sort(m_dense_ids.begin(), m_dense_ids.end());
+  auto samples = metadata.get_extent(Dimension::SAMPLE);
+  m_dense_samples = {(int64_t)samples.first, (int64_t)samples.second};
+}
+
+void OmicsExporter::retrieve(const std::array<int64_t, 2>& sample_range,
+                             const std::array<int64_t, 2>& position_range, process_function proc) {
+  if (m_dense) {
+    retrieve_dense(sample_range, position_range, proc);
+    return;
+  }
+  auto [pointers_vec, sizes_vec] = prepare_buffers();
+
+  auto row_range = m_schema->position_major() ? position_range : sample_range;
+  auto col_range = m_schema->position_major() ? sample_range : position_range;
+
+  int64_t subarray[] = {row_range[0],
+                        row_range[1],
+                        col_range[0],
+                        col_range[1],
+                        0,
+                        std::numeric_limits<int64_t>::max()};
+
+  m_array_storage->retrieve_by_cell(pointers_vec, sizes_vec, subarray, proc);
+}
+
+bool OmicsExporter::dense_subarray(const std::array<int64_t, 2>& sample_range,
+                                   const std::array<int64_t, 2>& position_range,
+                                   int64_t subarray[4]) {
+  auto first = std::lower_bound(m_dense_ids.begin(), m_dense_ids.end(),
+                                std::make_pair((uint64_t)position_range[0], (int64_t)0));
+  auto last = std::upper_bound(
+      first, m_dense_ids.end(),
+      std::make_pair((uint64_t)position_range[1], std::numeric_limits<int64_t>::max()));
+  int64_t samples[] = {std::max(sample_range[0], m_dense_samples[0]),
+                       std::min(sample_range[1], m_dense_samples[1])};
+  if (first == last || samples[0] > samples[1]) return false;
+
+  // the features in range are usually adjacent, those in between are skipped
+  int64_t indices[] = {std::numeric_limits<int64_t>::max(), 0};
+  for (auto it = first; it != last; it++) {
+    indices[0] = std::min(indices[0], it->second);
+    indices[1] = std::max(indices[1], it->second);
+  }
+  subarray[0] = indices[0];
+  subarray[1] = indices[1];
+  subarray[2] = samples[0];
+  subarray[3] = samples[1];
+  return true;
+}
+
+void OmicsExporter::retrieve_dense(const std::array<int64_t, 2>& sample_range,
+                                   const std::array<int64_t, 2>& position_range,
+                                   process_function proc) {
+  int64_t subarray[4];
+  if (!dense_subarray(sample_range, position_range, subarray)) return;
+
   auto [pointers_vec, sizes_vec] = prepare_buffers();
-  void** pointers = pointers_vec.data();
-  size_t* sizes = sizes_vec.data();
+  auto score = m_schema->slot<float>("SCORE");
+  m_array_storage->retrieve_by_cell(
+      pointers_vec, sizes_vec, subarray,
+      [&](const std::array<uint64_t, 3>& coords, const std::vector<OmicsFieldData>& data) {
+        auto& feature = m_dense_features[coords[1]];
+        if ((int64_t)feature.first < position_range[0] ||
+            (int64_t)feature.first > position_range[1]) {
+          return;
+        }
+        if (score.valid() && std::isnan(score.get(data))) return;  // missing from the matrices
+        proc({coords[0], feature.first, feature.second}, data);
+      });
+}
 
+void OmicsExporter::query_batches(process_batch_t proc, std::array<int64_t, 2> sample_range,
+                                  std::array<int64_t, 2> position_range) {
+  if (m_dense) {
+    query_dense_batches(sample_range, position_range, proc);
+    return;
+  }
   auto row_range = m_schema->position_major() ? position_range : sample_range;
   auto col_range = m_schema->position_major() ? sample_range : position_range;
-  // int64_t subarray[] = { 0, std::numeric_limits<int64_t>::max(), 0, 0, 0,
-  // std::numeric_limits<int64_t>::max() };
 
   int64_t subarray[] = {row_range[0],
                         row_range[1],
@@ -72,10 +192,51 @@ void OmicsExporter::query(std::array<int64_t, 2> sample_range,
                         0,
                         std::numeric_limits<int64_t>::max()};
 
-  m_array_storage->retrieve_by_cell(pointers_vec, sizes_vec, subarray,
-                                    proc ? proc
-                                         : std::bind(&OmicsExporter::process, this,
-                                                     std::placeholders::_1, std::placeholders::_2));
+  m_array_storage->retrieve_by_batch(subarray, m_batch_buffer_size, proc);
+}
+
+void OmicsExporter::query_dense_batches(const std::array<int64_t, 2>& sample_range,
+                                        const std::array<int64_t, 2>& position_range,
+                                        process_batch_t proc) {
+  int64_t subarray[4];
+  if (!dense_subarray(sample_range, position_range, subarray)) return;
+
+  // the cells kept are moved down over those of features out of range and of samples missing from
+  // the matrices. Dense arrays only have fixed length attributes
+  std::vector<size_t> cell_bytes;
+  for (auto& [_, info] : m_schema->attributes) {
+    cell_bytes.push_back(info.length * info.element_size());
+  }
+  auto score = m_schema->slot<float>("SCORE");
+  m_array_storage->retrieve_by_batch(
+      subarray, m_batch_buffer_size, [&](OmicsColumns& columns) {
+        auto scores = score.valid() ? columns.column(score) : nullptr;
+        size_t kept = 0;
+        for (size_t cell = 0; cell < columns.cells; cell++) {
+          auto& feature = m_dense_features[columns.positions[cell]];
+          if ((int64_t)feature.first < position_range[0] ||
+              (int64_t)feature.first > position_range[1] || (scores && std::isnan(scores[cell]))) {
+            continue;
+          }
+          columns.samples[kept] = columns.samples[cell];
+          columns.positions[kept] = feature.first;
+          columns.levels[kept] = feature.second;
+          for (auto i = 0u; i < cell_bytes.size() && kept != cell; i++) {
+            auto values = static_cast<uint8_t*>(columns.values[i]);
+            memcpy(values + kept * cell_bytes[i], values + cell * cell_bytes[i], cell_bytes[i]);
+          }
+          kept++;
+        }
+        if (!kept) return;
+        columns.cells = kept;
+        columns.samples.resize(kept);
+        columns.positions.resize(kept);
+        columns.levels.resize(kept);
+        for (auto i = 0u; i < cell_bytes.size(); i++) {
+          columns.value_sizes[i] = kept * cell_bytes[i];
+        }
+        proc(columns);
+      });
 }
 
 void OmicsExporter::process(const std::array<uint64_t, 3>& coords,
@@ -126,7 +287,6 @@ static std::string cigar_to_string(const uint32_t* cigar, size_t n_cigar) {
 
 SamExporter::SamExporter(const std::string& workspace, const std::string& array)
     : OmicsExporter(workspace, array) {
-  check("SAMPLE_NAME", OmicsFieldInfo(OmicsFieldInfo::OmicsFieldType::omics_char, -1));
   check("QNAME", OmicsFieldInfo(OmicsFieldInfo::OmicsFieldType::omics_char, -1));
   check("FLAG", OmicsFieldInfo(OmicsFieldInfo::OmicsFieldType::omics_uint16_t, 1));
   check("RNAME", OmicsFieldInfo(OmicsFieldInfo::OmicsFieldType::omics_char, -1));
@@ -138,6 +298,18 @@ SamExporter::SamExporter(const std::string& workspace, const std::string& array)
   check("TLEN", OmicsFieldInfo(OmicsFieldInfo::OmicsFieldType::omics_int32_t, 1));
   check("SEQ", OmicsFieldInfo(OmicsFieldInfo::OmicsFieldType::omics_char, -1));
   check("QUAL", OmicsFieldInfo(OmicsFieldInfo::OmicsFieldType::omics_char, -1));
+
+  m_qname = m_schema->slot<char>("QNAME");
+  m_flag = m_schema->slot<uint16_t>("FLAG");
+  m_rname = m_schema->slot<char>("RNAME");
+  m_pos = m_schema->slot<int32_t>("POS");
+  m_mapq = m_schema->slot<uint8_t>("MAPQ");
+  m_cigar = m_schema->slot<uint32_t>("CIGAR");
+  m_rnext = m_schema->slot<int32_t>("RNEXT");
+  m_pnext = m_schema->slot<int32_t>("PNEXT");
+  m_tlen = m_schema->slot<int32_t>("TLEN");
+  m_seq = m_schema->slot<char>("SEQ");
+  m_qual = m_schema->slot<char>("QUAL");
 }
 
 void SamExporter::export_sams(std::array<int64_t, 2> sample_range,
@@ -163,60 +335,43 @@ void SamExporter::sam_interface(std::map<int64_t, std::shared_ptr<std::ofstream>
   }
   file = files[row];
 
-  auto get_field = [&](const std::string& name) -> const OmicsFieldData& {  // TODO check bounds?
-    return data[m_schema->index_of_attribute(name)];
-  };
-
   // QNAME
-  auto& qname_data = get_field("QNAME");
-  std::string qname(qname_data.get_ptr<char>(), qname_data.size());
-  *file << qname << "\t";
+  file->write(m_qname.ptr(data), m_qname.size(data));
+  *file << "\t";
 
   // FLAG
-  auto& flag_data = get_field("FLAG");
-  *file << flag_data.get<uint16_t>() << "\t";
+  *file << m_flag.get(data) << "\t";
 
   // RNAME
-  auto& rname_data = get_field("RNAME");
-  std::string rname(rname_data.get_ptr<char>(), rname_data.size());
-  *file << rname << "\t";
+  file->write(m_rname.ptr(data), m_rname.size(data));
+  *file << "\t";
 
   // POS
-  auto& pos_data = get_field("POS");
-  *file << pos_data.get<int32_t>() << "\t";
+  *file << m_pos.get(data) << "\t";
 
   // MAPQ
-  auto& mapq_data = get_field("MAPQ");
-  *file << std::to_string(mapq_data.get<uint8_t>()) << "\t";
+  *file << std::to_string(m_mapq.get(data)) << "\t";
 
   // CIGAR
-  auto& cigar_data = get_field("CIGAR");
-  std::string cigar_string =
-      cigar_to_string(cigar_data.get_ptr<uint32_t>(), cigar_data.typed_size<uint32_t>());
+  std::string cigar_string = cigar_to_string(m_cigar.ptr(data), m_cigar.size(data));
   *file << cigar_string << "\t";
 
   // RNEXT
-  auto& rnext_data =
-      get_field("RNEXT");  // FIXME should be a string but htslib turns it into a int32_t
-  *file << rnext_data.get<int32_t>() << "\t";
+  // FIXME should be a string but htslib turns it into a int32_t
+  *file << m_rnext.get(data) << "\t";
 
   // PNEXT
-  auto& pnext_data = get_field("PNEXT");
-  *file << pnext_data.get<int32_t>() << "\t";
+  *file << m_pnext.get(data) << "\t";
 
   // TLEN
-  auto& tlen_data = get_field("TLEN");
-  *file << tlen_data.get<int32_t>() << "\t";
+  *file << m_tlen.get(data) << "\t";
 
   // SEQ
-  auto& seq_data = get_field("SEQ");
-  std::string seq(seq_data.get_ptr<char>(), seq_data.size());
-  *file << seq << "\t";
+  file->write(m_seq.ptr(data), m_seq.size(data));
+  *file << "\t";
 
   // QUAL
-  auto& qual_data = get_field("QUAL");
-  std::string qual(qual_data.get_ptr<char>(), qual_data.size());
-  *file << qual;
+  file->write(m_qual.ptr(data), m_qual.size(data));
 
   *file << std::endl;
 }
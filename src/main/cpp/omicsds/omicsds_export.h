@@ -14,23 +14,53 @@ class OmicsExporter : public OmicsDSModule {
   OmicsExporter(const std::string& workspace, const std::string& array)
       : OmicsDSModule(workspace, array) {
     deserialize_schema();
+    load_dense_features(FileUtility::append(workspace, array, "metadata"));
   }
 
   virtual ~OmicsExporter() {}
 
   // used to query given range
   // will use proc as callback if specified, otherwise will default to process
+  // reads and intervals with a SPAN attribute are passed once, with the coords of their start, and
+  // those that start before position_range but end in it are passed after the cells in the range
   void query(std::array<int64_t, 2> sample_range = {0, std::numeric_limits<int64_t>::max()},
              std::array<int64_t, 2> position_range = {0, std::numeric_limits<int64_t>::max()},
              process_function proc = 0);
 
+  // passes the cells in range to proc a chunk at a time, as columns. Unlike query, the cells of
+  // reads and intervals with a SPAN attribute are passed as stored, end cells included
+  void query_batches(
+      process_batch_t proc,
+      std::array<int64_t, 2> sample_range = {0, std::numeric_limits<int64_t>::max()},
+      std::array<int64_t, 2> position_range = {0, std::numeric_limits<int64_t>::max()});
+
  protected:
   // coords are in standard order SAMPLE, POSITION, COLLISION INDEX
   virtual void process(const std::array<uint64_t, 3>& coords,
                        const std::vector<OmicsFieldData>& data);
+  // passes every cell in range to proc, including the end cells of reads and intervals
+  void retrieve(const std::array<int64_t, 2>& sample_range,
+                const std::array<int64_t, 2>& position_range, process_function proc);
+  // dense arrays store the features imported by MatrixLoader by index, the indices of a range of
+  // encoded ids are found through the ids sorted with their index. Cells are passed with the
+  // encoded id as position and the version as level, like those of sparse arrays
+  bool m_dense = false;
+  std::vector<gtf_encoding_t> m_dense_features;
+  std::vector<std::pair<uint64_t, int64_t>> m_dense_ids;
+  std::array<int64_t, 2> m_dense_samples = {0, -1};
+  void load_dense_features(const std::string& metadata_path);
+  // subarray of the features and samples in range, false if there are none
+  bool dense_subarray(const std::array<int64_t, 2>& sample_range,
+                      const std::array<int64_t, 2>& position_range, int64_t subarray[4]);
+  void retrieve_dense(const std::array<int64_t, 2>& sample_range,
+                      const std::array<int64_t, 2>& position_range, process_function proc);
+  void query_dense_batches(const std::array<int64_t, 2>& sample_range,
+                           const std::array<int64_t, 2>& position_range, process_batch_t proc);
   std::vector<std::vector<uint8_t>> m_buffers_vector;
   std::pair<std::vector<void*>, std::vector<size_t>> prepare_buffers();
   size_t m_buffer_size = 10240;
+  // initial size of every column buffer of query_batches
+  size_t m_batch_buffer_size = 1 << 20;
   void check(const std::string& name,
              const OmicsFieldInfo& inf);  // check that an attribute exists in schema (useful for
                                           // specific data e.g. ensure that the data is actually
@@ -52,4 +82,10 @@ class SamExporter : public OmicsExporter {  // for exporting data as SAM files
   void sam_interface(std::map<int64_t, std::shared_ptr<std::ofstream>>& files,
                      const std::string& output_prefix, const std::array<uint64_t, 3>& coords,
                      const std::vector<OmicsFieldData>& data);
+
+  FieldSlot<char> m_qname, m_rname, m_seq, m_qual;
+  FieldSlot<uint16_t> m_flag;
+  FieldSlot<int32_t> m_pos, m_rnext, m_pnext, m_tlen;
+  FieldSlot<uint8_t> m_mapq;
+  FieldSlot<uint32_t> m_cigar;
 };
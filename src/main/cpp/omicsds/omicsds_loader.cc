@@ -125,12 +125,13 @@ GenomicMap::GenomicMap(std::shared_ptr<FileUtility> mapping_reader) { initialize
 
 void GenomicMap::initialize(std::shared_ptr<FileUtility> mapping_reader) {
   m_mapping_reader = mapping_reader;
-  std::string str;
+  OmicsLineReader lines(m_mapping_reader);
+  std::string_view str;
   int line_num = -1;
-  while (m_mapping_reader->generalized_getline(str)) {
+  while (lines.next_line(str)) {
     line_num++;
 
-    auto toks = split(str, "\t");
+    auto toks = split(std::string(str), "\t");
     if (toks.size() < 3) {
       std::cerr
           << "Warning: line " << line_num << " of mapping file " << m_mapping_reader->filename
@@ -195,6 +196,42 @@ uint64_t GenomicMap::flatten(std::string contig_name, uint64_t offset) {
   }
 }
 
+std::pair<std::string, uint64_t> GenomicMap::unflatten(uint64_t position) {
+  auto it = std::upper_bound(idxs_position.begin(), idxs_position.end(), position,
+                             [&](auto l, auto r) { return l < contigs[r].starting_index; });
+
+  if (it != idxs_position.begin()) {
+    auto& contig = contigs[*std::prev(it)];
+    if (position - contig.starting_index < contig.length) {
+      return {contig.name, position - contig.starting_index};
+    }
+  }
+  std::cerr << "Error, position " << position << " is not in any contig of mapping file "
+            << m_mapping_reader->filename << std::endl;
+  exit(1);
+}
+
+uint64_t GenomicMap::contig_length(const std::string& contig_name) const {
+  auto it = std::lower_bound(idxs_name.begin(), idxs_name.end(), contig_name,
+                             [&](auto l, auto r) { return contigs[l].name < r; });
+  if (it != idxs_name.end() && contigs[*it].name == contig_name) {
+    return contigs[*it].length;
+  }
+  return 0;
+}
+
+std::vector<uint64_t> GenomicMap::contig_boundaries() const {
+  std::vector<uint64_t> boundaries;
+  for (auto idx : idxs_position) {
+    boundaries.push_back(contigs[idx].starting_index);
+  }
+  if (!idxs_position.empty()) {
+    auto& last = contigs[idxs_position.back()];
+    boundaries.push_back(last.starting_index + last.length);
+  }
+  return boundaries;
+}
+
 bool equivalent_schema(const OmicsSchema& l, const OmicsSchema& r) {
   if (l.attributes.size() != r.attributes.size()) return false;
 
@@ -336,15 +373,284 @@ bool OmicsCell::is_invalid_cell(const OmicsCell& cell) {
   return cell.coords[0] < 0 || cell.coords[1] < 0;
 }
 
+OmicsCell OmicsCell::copy(OmicsArena& arena) const {
+  size_t bytes = num_fields * sizeof(Field);
+  for (auto i = 0u; i < num_fields; i++) {
+    bytes += fields[i].length;
+  }
+
+  OmicsCell cell = *this;
+  cell.fields = reinterpret_cast<Field*>(arena.allocate(bytes, &cell.block));
+  uint8_t* data = reinterpret_cast<uint8_t*>(cell.fields + num_fields);
+  for (auto i = 0u; i < num_fields; i++) {
+    if (fields[i].length) memcpy(data, fields[i].data, fields[i].length);
+    cell.fields[i] = {data, fields[i].length};
+    data += fields[i].length;
+  }
+  return cell;
+}
+
+void CellBatch::reset(std::shared_ptr<OmicsSchema> schema, size_t max_cells) {
+  this->schema = schema;
+  this->max_cells = max_cells;
+  auto num_attributes = schema->attributes.size();
+  data.resize(num_attributes);
+  offsets.resize(num_attributes);
+  var_data.resize(num_attributes);
+  m_element_sizes.clear();
+  for (auto& attribute : schema->attributes) {
+    auto& info = attribute.second;
+    m_element_sizes.push_back(info.is_variable() ? 0 : info.element_size() * info.length);
+  }
+  clear();
+}
+
+void CellBatch::clear() {
+  coords.clear();
+  end_positions.clear();
+  levels.clear();
+  for (auto i = 0u; i < data.size(); i++) {
+    data[i].clear();
+    offsets[i].clear();
+    var_data[i].clear();
+  }
+  end_cells.clear();
+  arena.reset();
+}
+
+void CellBatch::add_cell(const std::array<int64_t, 2>& cell_coords, int64_t end_position,
+                         int level) {
+  coords.push_back(cell_coords);
+  end_positions.push_back(end_position);
+  levels.push_back(level);
+  for (auto i = 0u; i < m_element_sizes.size(); i++) {
+    if (!m_element_sizes[i]) {
+      offsets[i].push_back(var_data[i].size());
+    }
+  }
+}
+
+void CellBatch::append_cell(const OmicsCell& cell) {
+  assert(cell.num_fields == m_element_sizes.size());
+  add_cell(cell.coords);
+  for (auto i = 0u; i < cell.num_fields; i++) {
+    append(i, cell.fields[i].data, cell.fields[i].length);
+  }
+}
+
+OmicsCell CellBatch::cell(size_t row, int file_idx, OmicsArena& arena) const {
+  // fields and their data in one allocation, see OmicsCell::copy
+  size_t bytes = m_element_sizes.size() * sizeof(OmicsCell::Field);
+  for (auto i = 0u; i < m_element_sizes.size(); i++) {
+    bytes += length(i, row);
+  }
+
+  OmicsCell cell;
+  cell.coords = coords[row];
+  cell.file_idx = file_idx;
+  cell.num_fields = m_element_sizes.size();
+  cell.fields = reinterpret_cast<OmicsCell::Field*>(arena.allocate(bytes, &cell.block));
+  uint8_t* dst = reinterpret_cast<uint8_t*>(cell.fields + cell.num_fields);
+  for (auto i = 0u; i < cell.num_fields; i++) {
+    uint32_t bytes = length(i, row);
+    if (bytes) memcpy(dst, field(i, row), bytes);
+    cell.fields[i] = {dst, bytes};
+    dst += bytes;
+  }
+  return cell;
+}
+
+bool CellBatch::validate() const {
+  for (auto i = 0u; i < m_element_sizes.size(); i++) {
+    if (m_element_sizes[i] ? data[i].size() != size() * m_element_sizes[i]
+                           : offsets[i].size() != size()) {
+      return false;
+    }
+  }
+  return end_positions.size() == size() && levels.size() == size();
+}
+
+void CellBatch::append_row(const CellBatch& other, size_t row) {
+  add_cell(other.coords[row], other.end_positions[row], other.levels[row]);
+  for (auto i = 0u; i < m_element_sizes.size(); i++) {
+    append(i, other.field(i, row), other.length(i, row));
+  }
+}
+
+void CellBatch::append_batch(const CellBatch& other) {
+  coords.insert(coords.end(), other.coords.begin(), other.coords.end());
+  end_positions.insert(end_positions.end(), other.end_positions.begin(),
+                       other.end_positions.end());
+  levels.insert(levels.end(), other.levels.begin(), other.levels.end());
+  for (auto i = 0u; i < m_element_sizes.size(); i++) {
+    if (m_element_sizes[i]) {
+      data[i].insert(data[i].end(), other.data[i].begin(), other.data[i].end());
+    } else {
+      size_t base = var_data[i].size();
+      for (auto offset : other.offsets[i]) {
+        offsets[i].push_back(base + offset);
+      }
+      var_data[i].insert(var_data[i].end(), other.var_data[i].begin(), other.var_data[i].end());
+    }
+  }
+}
+
+size_t CellBatch::bytes() const {
+  size_t bytes = size() * (sizeof(coords[0]) + sizeof(end_positions[0]) + sizeof(levels[0]));
+  for (auto i = 0u; i < m_element_sizes.size(); i++) {
+    bytes += data[i].size() + offsets[i].size() * sizeof(size_t) + var_data[i].size();
+  }
+  return bytes;
+}
+
+void CellBatch::serialize(std::string& out) const {
+  auto put = [&out](const void* ptr, size_t bytes) {
+    out.append(reinterpret_cast<const char*>(ptr), bytes);
+  };
+  uint64_t cells = size();
+  put(&cells, sizeof(cells));
+  put(coords.data(), cells * sizeof(coords[0]));
+  put(end_positions.data(), cells * sizeof(end_positions[0]));
+  put(levels.data(), cells * sizeof(levels[0]));
+  for (auto i = 0u; i < m_element_sizes.size(); i++) {
+    if (m_element_sizes[i]) {
+      put(data[i].data(), data[i].size());
+    } else {
+      uint64_t var_bytes = var_data[i].size();
+      put(offsets[i].data(), cells * sizeof(size_t));
+      put(&var_bytes, sizeof(var_bytes));
+      put(var_data[i].data(), var_bytes);
+    }
+  }
+}
+
+size_t CellBatch::deserialize(const uint8_t* in) {
+  clear();
+  const uint8_t* next = in;
+  auto get = [&next](void* ptr, size_t bytes) {
+    if (bytes) memcpy(ptr, next, bytes);
+    next += bytes;
+  };
+  uint64_t cells;
+  get(&cells, sizeof(cells));
+  coords.resize(cells);
+  end_positions.resize(cells);
+  levels.resize(cells);
+  get(coords.data(), cells * sizeof(coords[0]));
+  get(end_positions.data(), cells * sizeof(end_positions[0]));
+  get(levels.data(), cells * sizeof(levels[0]));
+  for (auto i = 0u; i < m_element_sizes.size(); i++) {
+    if (m_element_sizes[i]) {
+      data[i].resize(cells * m_element_sizes[i]);
+      get(data[i].data(), data[i].size());
+    } else {
+      uint64_t var_bytes;
+      offsets[i].resize(cells);
+      get(offsets[i].data(), cells * sizeof(size_t));
+      get(&var_bytes, sizeof(var_bytes));
+      var_data[i].resize(var_bytes);
+      get(var_data[i].data(), var_bytes);
+    }
+  }
+  return next - in;
+}
+
+bool OmicsFileReader::get_next_batch(CellBatch& batch) {
+  batch.clear();
+  while (!batch.full()) {
+    auto cells = get_next_cells();
+    if (cells.empty() || OmicsCell::is_invalid_cell(cells[0])) break;
+    for (auto& cell : cells) {
+      if (OmicsCell::is_invalid_cell(cell)) continue;
+      if (cell.file_idx < 0) {
+        // the fields of cell are only valid until the next get_next_cells()
+        batch.end_cells.emplace_back(cell.copy(batch.arena));
+      } else {
+        batch.append_cell(cell);
+      }
+    }
+  }
+  return !batch.empty();
+}
+
+std::array<int64_t, 2> OmicsFileReader::first_coords() const {
+  std::array<int64_t, 2> first = {std::numeric_limits<int64_t>::min(),
+                                  std::numeric_limits<int64_t>::min()};
+  if (!m_schema->position_major()) {
+    first[0] = sample_rows()[0];
+  }
+  return first;
+}
+
+std::vector<OmicsCell> OmicsFileReader::get_next_cells_from_batch() {
+  if (!m_cell_batch) {
+    m_cell_batch = std::make_unique<CellBatch>(m_schema, 1);
+  }
+  m_arena.reset();
+  std::vector<OmicsCell> cells;
+  if (get_next_batch(*m_cell_batch)) {
+    for (auto row = 0u; row < m_cell_batch->size(); row++) {
+      cells.emplace_back(m_cell_batch->cell(row, m_file_idx, m_arena));
+      if (m_cell_batch->end_positions[row] >= 0) {
+        OmicsCell end_cell = cells.back();  // shares the fields of the cell
+        end_cell.file_idx = -1;
+        end_cell.coords[1] = m_cell_batch->end_positions[row];
+        cells.emplace_back(std::move(end_cell));
+      }
+    }
+  }
+  return cells;
+}
+
+// ASCII of both bases packed in a byte of SEQ
+static const std::array<std::array<char, 2>, 256> seq_nt16_pairs = [] {
+  std::array<std::array<char, 2>, 256> pairs;
+  for (auto i = 0u; i < pairs.size(); i++) {
+    pairs[i] = {seq_nt16_str[i >> 4], seq_nt16_str[i & 0xf]};
+  }
+  return pairs;
+}();
+
 SamReader::SamReader(std::string filename, std::shared_ptr<OmicsSchema> schema,
-                     std::shared_ptr<SampleMap> sample_map, int file_idx)
-    : OmicsFileReader(filename, schema, sample_map, file_idx) {
-  m_fp = hts_open(filename.c_str(), "r");  // open bam file
-  m_hdr = sam_hdr_read(m_fp);              // read header
-  m_align = bam_init1();                   // initialize an alignment
+                     std::shared_ptr<SampleMap> sample_map, int file_idx,
+                     int decompression_threads, std::array<int64_t, 2> position_range)
+    : OmicsFileReader(filename, schema, sample_map, file_idx, 0) {  // htslib buffers the file
+  m_fp = hts_open(filename.c_str(), "r");  // open sam, bam or cram file
+  if (!m_fp) {
+    std::cerr << "Error, could not open " << filename << std::endl;
+    exit(1);
+  }
+  if (decompression_threads > 0 && hts_set_threads(m_fp, decompression_threads) < 0) {
+    std::cerr << "Error, could not start decompression threads for " << filename << std::endl;
+  }
+  m_hdr = sam_hdr_read(m_fp);  // read header
+  m_align = bam_init1();       // initialize an alignment
 
   if (!m_hdr) {
     std::cout << "SamReader header is null" << std::endl;
+  } else {
+    m_contigs.resize(m_hdr->n_targets);
+  }
+
+  // regions of the contigs in range, in flattened order
+  bool bounded = position_range[0] != std::numeric_limits<int64_t>::min() ||
+                 position_range[1] != std::numeric_limits<int64_t>::max();
+  if (bounded && m_hdr && (m_idx = sam_index_load(m_fp, filename.c_str()))) {
+    std::map<std::string, int> tids;
+    for (int tid = 0; tid < m_hdr->n_targets; tid++) {
+      tids.emplace(m_hdr->target_name[tid], tid);
+    }
+    auto contigs = schema->genomic_map.contig_boundaries();
+    for (auto i = 0u; i + 1 < contigs.size(); i++) {
+      int64_t start = contigs[i], end = contigs[i + 1];
+      if (end <= position_range[0] || start >= position_range[1]) continue;
+      auto tid = tids.find(schema->genomic_map.unflatten(start).first);
+      if (tid == tids.end()) continue;  // no reads
+      // flattened positions are one based offsets from the start of the contig. The index only
+      // passes reads whose alignment overlaps the region, while end cells are at the end of their
+      // template, so the region starts with the contig
+      m_regions.push_back({tid->second, 0, std::min(end, position_range[1]) - start - 1});
+    }
   }
 
   auto toks = split(filename, "/");
@@ -362,91 +668,140 @@ SamReader::SamReader(std::string filename, std::shared_ptr<OmicsSchema> schema,
   }
 
   assert((bool)schema);
+  m_qname = schema->slot<char>("QNAME");
+  m_flag = schema->slot<uint16_t>("FLAG");
+  m_rname = schema->slot<char>("RNAME");
+  m_pos = schema->slot<int32_t>("POS");
+  m_mapq = schema->slot<uint8_t>("MAPQ");
+  m_cigar = schema->slot<uint32_t>("CIGAR");
+  m_rnext = schema->slot<int32_t>("RNEXT");
+  m_pnext = schema->slot<int32_t>("PNEXT");
+  m_tlen = schema->slot<int32_t>("TLEN");
+  m_seq = schema->slot<char>("SEQ");
+  m_qual = schema->slot<char>("QUAL");
+  m_span = schema->slot<int64_t>("SPAN");
 }
 
 SamReader::~SamReader() {
   // std::cout << "REMOVE SamReader::~SamReader" << std::endl;
   // std::cout << "FIXME uncomment cleanup functions" << std::endl;
+  if (m_itr) hts_itr_destroy(m_itr);
+  if (m_idx) hts_idx_destroy(m_idx);
   bam_destroy1(m_align);
+  bam_hdr_destroy(m_hdr);
   sam_close(m_fp);
 }
 
-std::vector<OmicsCell> SamReader::get_next_cells() {
-  std::vector<OmicsCell> cells;
+bool SamReader::get_next_batch(CellBatch& batch) {
+  batch.clear();
 
-  int rc;
-  if (!(rc = sam_read1(m_fp, m_hdr, m_align))) {
+  // fields are copied straight from the alignment with the lengths it records, so the batch columns
+  // are filled without intermediate copies
+  while (!batch.full() && read_next()) {
+    if (m_align->core.tid < 0) continue;  // unmapped
     int32_t pos =
         m_align->core.pos + 1;  // left most position of alignment in zero based coordinate (+1)
     char* chr = m_hdr->target_name[m_align->core.tid];  // contig name (chromosome)
-    uint32_t len = m_align->core.l_qseq;                // length of the read.
-
-    uint8_t* q = bam_get_seq(m_align);  // quality string
-    uint32_t q2 = m_align->core.qual;   // mapping quality
+    auto& contig = this->contig(m_align->core.tid);
+    uint32_t len = m_align->core.l_qseq;  // length of the read.
 
+    uint8_t* q = bam_get_seq(m_align);  // 4 bit encoded sequence
     char* qname = bam_get_qname(m_align);
+    size_t qname_length = m_align->core.l_qname - m_align->core.l_extranul - 1;
     uint16_t flag = m_align->core.flag;
     uint32_t* cigar = bam_get_cigar(m_align);
     uint32_t n_cigar = m_align->core.n_cigar;
-    char cigar_codes[] = {'M', 'I', 'D', 'N', 'S', 'H', 'P', '=', 'X'};
-    // uint8_t* qual = bam_get_qual(m_align);
-
     char* qual = (char*)bam_get_qual(m_align);
     uint8_t mapq = m_align->core.qual;
-    // char* seq = (char*)bam_get_seq(m_align);
     int32_t rnext = m_align->core.mtid;
     int32_t pnext = m_align->core.mpos;
     int32_t tlen = m_align->core.isize;
-    std::vector<char> qseq(len);
 
-    for (size_t i = 0; i < len; i++) {
-      qseq[i] = seq_nt16_str[bam_seqi(q, i)];  // gets nucleotide id and converts them into IUPAC
-                                               // id.
+    int64_t position = contig.start + pos;
+    int64_t end_offset = std::abs(tlen) - 1;  // FIXME figure out negative template length
+
+    // if end cell is in same position, only create one cell. Templates that run past the end of
+    // the contig end with it, the array domain ends with the last contig
+    int64_t end_position = tlen ? std::min(position + end_offset, contig.end) : -1;
+    batch.add_cell({(int64_t)m_row_idx, position}, end_position);
+    std::array<int64_t, 2> span = {position, std::max(position, end_position)};
+    batch.append(m_span, span.data(), span.size());
+    batch.append(m_qname, qname, qname_length);
+    batch.append_value(m_flag, flag);
+    batch.append(m_rname, chr, contig.name_length);
+    batch.append_value(m_pos, pos);
+    batch.append_value(m_mapq, mapq);
+    batch.append(m_cigar, cigar, n_cigar);
+    batch.append_value(m_rnext, rnext);
+    batch.append_value(m_pnext, pnext);
+    batch.append_value(m_tlen, tlen);
+    if (m_seq.valid()) {
+      // gets nucleotide ids and converts them into IUPAC ids, a byte of two at a time
+      char* seq = batch.extend(m_seq, len);
+      for (size_t i = 0; i < len / 2; i++) {
+        memcpy(seq + 2 * i, seq_nt16_pairs[q[i]].data(), 2);
+      }
+      if (len % 2) {
+        seq[len - 1] = seq_nt16_str[bam_seqi(q, len - 1)];
+      }
+    }
+    // htslib decodes QUAL to binary phred scores and a missing QUAL to 0xff, store them as the
+    // SAM text so that exports write them unchanged
+    if (!len || (uint8_t)qual[0] == 0xff) {
+      batch.append(m_qual, "*", 1);
+    } else {
+      char* text = batch.extend(m_qual, len);
+      for (size_t i = 0; i < len; i++) {
+        text[i] = qual[i] + 33;
+      }
     }
+  }
+  return batch.size();
+}
 
-    std::string sample = get_filename();
-
-    int64_t position = m_schema->genomic_map.flatten(chr, pos);
-
-    std::cerr << "\t\t\t\tREMOVE rname len " << std::strlen(chr) << std::endl;
-    std::cerr << "\t\t\t\tREMOVE cigar len " << n_cigar << std::endl;
-
-    OmicsCell cell({(int64_t)m_row_idx, position}, m_schema, m_file_idx);
-    cell.add_field_ptr("QNAME", qname, std::strlen(qname));
-    cell.add_field("FLAG", flag);
-    cell.add_field_ptr("RNAME", chr, std::strlen(chr));
-    cell.add_field("POS", pos);
-    cell.add_field("MAPQ", mapq);
-    cell.add_field_ptr("CIGAR", cigar, n_cigar);
-    cell.add_field("RNEXT", rnext);
-    cell.add_field("PNEXT", pnext);
-    cell.add_field("TLEN", tlen);
-    cell.add_field_ptr("SEQ", qseq.data(), (int)qseq.size());
-    cell.add_field_ptr("QUAL", qual, std::strlen(qual));
-
-    // FIXME REMOVE
-    cell.add_field_ptr("SAMPLE_NAME", (char*)sample.c_str(), (int)sample.length());
-
-    OmicsCell end_cell = cell;
-    end_cell.file_idx = -1;
-    int end_offset = std::abs(tlen) - 1;  // FIXME figure out negative template length
-    end_cell.coords[1] += end_offset;
-    if (tlen) {  // if end cell is in same position, only create one cell
-      std::cout << "REMOVE SamReader::get_next_cells return " << cell.coords[1] << ", "
-                << end_cell.coords[1] << std::endl;
-      return {cell, end_cell};
-    }
-    std::cout << "REMOVE SamReader::get_next_cells return " << cell.coords[1] << std::endl;
-    return {cell};
-  } else {
-    std::cout << "REMOVE sam_read1 was " << rc << std::endl;
-    return {OmicsCell::create_invalid_cell()};
+const SamReader::Contig& SamReader::contig(int tid) {
+  auto& contig = m_contigs[tid];
+  if (contig.start < 0) {
+    const char* name = m_hdr->target_name[tid];
+    contig.start = m_schema->genomic_map.flatten(name, 0);
+    contig.end = contig.start + m_schema->genomic_map.contig_length(name);
+    contig.name_length = std::strlen(name);
   }
+  return contig;
+}
+
+bool SamReader::read_next() {
+  if (!m_idx) {
+    return sam_read1(m_fp, m_hdr, m_align) >= 0;
+  }
+  while (m_region < m_regions.size()) {
+    if (!m_itr) {
+      auto& region = m_regions[m_region];
+      m_itr = sam_itr_queryi(m_idx, region.tid, region.begin, region.end);
+    }
+    if (m_itr && sam_itr_next(m_fp, m_itr, m_align) >= 0) {
+      return true;
+    }
+    if (m_itr) hts_itr_destroy(m_itr);
+    m_itr = nullptr;
+    m_region++;
+  }
+  return false;
 }
 
 BedReader::BedReader(std::string filename, std::shared_ptr<OmicsSchema> schema,
-                     std::shared_ptr<SampleMap> sample_map, int file_idx)
-    : OmicsFileReader(filename, schema, sample_map, file_idx) {
+                     std::shared_ptr<SampleMap> sample_map, int file_idx, size_t buffer_size)
+    : OmicsFileReader(filename, schema, sample_map, file_idx, buffer_size),
+      m_lines(m_reader_util, buffer_size / 4) {
+  m_chrom = schema->slot<char>("CHROM");
+  m_start = schema->slot<uint64_t>("START");
+  m_end = schema->slot<uint64_t>("END");
+  m_score = schema->slot<float>("SCORE");
+  m_gene = schema->slot<char>("GENE");
+  m_sample = schema->slot<char>("SAMPLE_NAME");
+  m_name = schema->slot<char>("NAME");
+  m_span = schema->slot<int64_t>("SPAN");
+
   std::string line;
   if (!m_reader_util->generalized_getline(line)) {
     std::cerr << "Error file " << filename << " is empty, skipping" << std::endl;
@@ -465,8 +820,6 @@ BedReader::BedReader(std::string filename, std::shared_ptr<OmicsSchema> schema,
   }
 
   m_sample_name = m[1];
-  std::cout << "************************************** BED sample is " << m_sample_name
-            << std::endl;
 
   if (!m_sample_map->count(m_sample_name)) {
     std::cerr << "Error, sample " << m_sample_name << " from file " << filename
@@ -477,10 +830,12 @@ BedReader::BedReader(std::string filename, std::shared_ptr<OmicsSchema> schema,
   m_row_idx = (*m_sample_map)[m_sample_name];
 }
 
-std::vector<OmicsCell> BedReader::get_next_cells() {
-  std::string line;
-  while (m_reader_util->generalized_getline(line)) {
-    std::stringstream ss(line);
+bool BedReader::get_next_batch(CellBatch& batch) {
+  batch.clear();
+
+  std::string_view line;
+  while (!batch.full() && m_lines.next_line(line)) {
+    std::stringstream ss{std::string(line)};
     std::string str;
     std::vector<std::string> fields;
     while (ss >> str) {
@@ -498,36 +853,34 @@ std::vector<OmicsCell> BedReader::get_next_cells() {
       start = std::stoul(fields[1]);
       flattened_start = m_schema->genomic_map.flatten(chrom, start);
       end = std::stoul(fields[2]);
-      flattened_end = m_schema->genomic_map.flatten(chrom, end);
+      // intervals that run past the end of the contig end with it
+      flattened_end = m_schema->genomic_map.flatten(
+          chrom, std::min(end, m_schema->genomic_map.contig_length(chrom) - 1));
       score = std::stof(fields[4]);
     } catch (...) {
       continue;
     }
 
-    OmicsCell cell({(int64_t)m_row_idx, (int64_t)flattened_start}, m_schema, m_file_idx);
-    cell.add_field_ptr("CHROM", chrom.c_str(), chrom.length());
-    cell.add_field("START", start);
-    cell.add_field("END", end);
-    cell.add_field("SCORE", score);
-    cell.add_field_ptr("GENE", gene.c_str(), gene.length());
-    cell.add_field_ptr("SAMPLE_NAME", m_sample_name.c_str(), m_sample_name.length());
-    cell.add_field_ptr("NAME", name.c_str(), name.length());
-
-    OmicsCell end_cell = cell;
-    end_cell.file_idx = -1;
-    end_cell.coords[1] = flattened_end;
-
-    if (flattened_start == flattened_end) {
-      return {cell};
-    }
-    return {cell, end_cell};
+    batch.add_cell({(int64_t)m_row_idx, (int64_t)flattened_start},
+                   flattened_start == flattened_end ? -1 : (int64_t)flattened_end);
+    batch.append(m_chrom, chrom.c_str(), chrom.length());
+    batch.append_value(m_start, start);
+    batch.append_value(m_end, end);
+    batch.append_value(m_score, score);
+    batch.append(m_gene, gene.c_str(), gene.length());
+    batch.append(m_sample, m_sample_name.c_str(), m_sample_name.length());
+    batch.append(m_name, name.c_str(), name.length());
+    std::array<int64_t, 2> span = {(int64_t)flattened_start, (int64_t)flattened_end};
+    batch.append(m_span, span.data(), span.size());
   }
-  return {};
+  return batch.size();
 }
 
 MatrixReader::MatrixReader(std::string filename, std::shared_ptr<OmicsSchema> schema,
-                           std::shared_ptr<SampleMap> sample_map, int file_idx)
-    : OmicsFileReader(filename, schema, sample_map, file_idx) {
+                           std::shared_ptr<SampleMap> sample_map, int file_idx,
+                           bool match_schema_order, size_t buffer_size)
+    : OmicsFileReader(filename, schema, sample_map, file_idx, buffer_size),
+      m_lines(m_reader_util, buffer_size / 4) {
   std::string line;
 
   if (!m_reader_util->generalized_getline(line)) {
@@ -546,90 +899,850 @@ MatrixReader::MatrixReader(std::string filename, std::shared_ptr<OmicsSchema> sc
                       "\"SAMPLE\t[sample1]\t[sample2]\"\n  for a header")));
   }
 
-  if (m_id_major != m_schema->position_major()) {
+  if (match_schema_order && m_id_major != m_schema->position_major()) {
     logger.fatal(OmicsDSException(
         logger.format("Error order of matrix file {} does not match that of schema, they should "
-                      "both be either gene/transcript id major or sample major",
+                      "both be either gene/transcript id major or sample major, or the input "
+                      "should be sorted",
                       filename)));
   }
 
   m_columns = std::vector<std::string>(toks.begin() + 1, toks.end());
   m_row_scores = std::vector<float>(m_columns.size(), 0);
   m_column_idx = m_columns.size();  // to force parsing next line
+  m_score = schema->slot<float>("SCORE");
+
+  for (auto& column : m_columns) {
+    if (m_id_major) {
+      m_column_rows.push_back(sample_row(column));
+    } else {
+      m_column_ids.push_back(gene_id(column));
+    }
+  }
+}
+
+int64_t MatrixReader::sample_row(const std::string& sample) {
+  if (!m_sample_map->count(sample)) {
+    return -1;
+  }
+  return (*m_sample_map)[sample];
+}
+
+gtf_encoding_t MatrixReader::gene_id(const std::string& gene) {
+  gtf_encoding_t encoded_id = encode_gtf_id(gene);
+  logger.debug("Gene={} Encoded ID={:#08x} {:#08x}", gene, encoded_id.first, encoded_id.second);
+  if (!encoded_id.first) {
+    logger.error("Gene name {} cannot be encoded", gene);
+  }
+  return encoded_id;
+}
+
+bool MatrixReader::parse_line() {
+  std::string_view line;
+  if (!m_lines.next_line(line)) {
+    logger.debug("*** End of input!!!");
+    return false;
+  }
+
+  OmicsTokenizer tokenizer(line, m_token_separator[0], m_token_separator[1]);
+  std::string_view token;
+  tokenizer.next(token);
+  size_t num_columns = 0;
+  bool numbers = true;
+  for (std::string_view score; tokenizer.next(score); num_columns++) {
+    if (num_columns < m_row_scores.size()) {
+      numbers = parse_float(score, m_row_scores[num_columns]) && numbers;
+    }
+  }
+  if (num_columns != m_columns.size()) {  // sample/gene id followed by scores
+    logger.fatal(OmicsDSException(logger.format("Error with matrix cell values in input, number "
+                                                "of columns({}) do not match header({})",
+                                                num_columns, m_columns.size())),
+                 "Erroneous line from file({}) : \n{}{}", get_filename(), line.substr(0, 60),
+                 line.length() > 59 ? "..." : "");
+  }
+  if (!numbers) {
+    logger.fatal(
+        OmicsDSException("Error with matrix cell values in input, they have to be numbers"));
+  }
+
+  // the row token is looked up once for all the cells in the line
+  if (m_id_major) {
+    m_current_id = gene_id(std::string(token));
+  } else {
+    m_current_row = sample_row(std::string(token));
+  }
+  m_column_idx = 0;
+  return true;
+}
+
+bool MatrixReader::get_next_batch(CellBatch& batch) {
+  batch.clear();
+
+  while (!batch.full()) {
+    if (m_column_idx >= m_row_scores.size() && !parse_line()) {
+      break;
+    }
+    for (; m_column_idx < m_row_scores.size() && !batch.full(); m_column_idx++) {
+      int64_t row = m_id_major ? m_column_rows[m_column_idx] : m_current_row;
+      gtf_encoding_t& id = m_id_major ? m_current_id : m_column_ids[m_column_idx];
+      if (row < 0 || !id.first) {
+        continue;
+      }
+      batch.add_cell({row, (int64_t)id.first}, -1, id.second);
+      batch.append_value(m_score, m_row_scores[m_column_idx]);
+    }
+    if (m_row_scores.empty()) {  // a header without columns has no cells
+      break;
+    }
+  }
+  return batch.size();
+}
+
+SortingReader::SortingReader(std::shared_ptr<OmicsFileReader> reader, const std::string& run_prefix,
+                             size_t run_bytes, size_t resident_bytes, size_t block_size,
+                             std::array<int64_t, 2> range)
+    : OmicsFileReader(*reader),
+      m_reader(reader),
+      m_run_prefix(run_prefix),
+      m_run_bytes(run_bytes),
+      m_resident_bytes(resident_bytes),
+      m_block_size(std::max<size_t>(block_size, 1)),
+      m_range(range) {}
+
+SortingReader::~SortingReader() {
+  for (auto& run : m_runs) {
+    if (run.file) {
+      FileUtility::delete_file(run.filename);
+    }
+  }
+}
+
+bool SortingReader::in_range(const CellBatch& batch, size_t row) const {
+  auto in_range = [this](const std::array<int64_t, 2>& coords) {
+    auto key = m_schema->swap_order(coords)[0];
+    return key >= m_range[0] && key < m_range[1];
+  };
+  if (in_range(batch.coords[row])) return true;
+  if (batch.end_positions[row] < 0) return false;
+  return in_range({batch.coords[row][0], batch.end_positions[row]});
+}
+
+std::vector<size_t> SortingReader::sorted_rows(const CellBatch& run) const {
+  std::vector<std::array<int64_t, 2>> keys;
+  keys.reserve(run.size());
+  for (auto& coords : run.coords) {
+    keys.push_back(m_schema->swap_order(coords));
+  }
+  std::vector<size_t> rows(run.size());
+  std::iota(rows.begin(), rows.end(), 0);
+  if (!std::is_sorted(keys.begin(), keys.end())) {
+    // stable so that cells at the same coordinates keep the order of the file
+    std::stable_sort(rows.begin(), rows.end(),
+                     [&keys](size_t l, size_t r) { return keys[l] < keys[r]; });
+  }
+  return rows;
+}
+
+// writes rows of run in that order to filename as serialized blocks of block_size cells, every
+// block is preceded by its size in bytes
+static void write_run(const std::string& filename, const CellBatch& run,
+                      const std::vector<size_t>& rows, size_t block_size) {
+  const size_t write_size = 4 * 1024 * 1024;  // bytes of serialized blocks per write
+  CellBatch block(run.schema, block_size);
+  std::string out;
+  bool overwrite = true;
+  for (size_t begin = 0; begin < rows.size(); begin += block_size) {
+    block.clear();
+    for (auto i = begin; i < std::min(begin + block_size, rows.size()); i++) {
+      block.append_row(run, rows[i]);
+    }
+    size_t header = out.size();
+    uint64_t bytes = 0;
+    out.append(sizeof(bytes), 0);
+    block.serialize(out);
+    bytes = out.size() - header - sizeof(bytes);
+    memcpy(&out[header], &bytes, sizeof(bytes));
+    if (out.size() >= write_size || begin + block_size >= rows.size()) {
+      FileUtility::write_file(filename, out, overwrite);
+      overwrite = false;
+      out.clear();
+    }
+  }
+}
+
+// replaces block with the next block of a run written by write_run, false at the end of the run
+static bool read_run_block(FileUtility& file, std::vector<uint8_t>& buffer, CellBatch& block) {
+  if (file.chars_read >= file.file_size) return false;
+  uint64_t bytes;
+  file.read_file(&bytes, sizeof(bytes));
+  buffer.resize(bytes);
+  file.read_file(buffer.data(), bytes);
+  block.deserialize(buffer.data());
+  return true;
+}
+
+void SortingReader::spill(const CellBatch& run) {
+  std::string filename = m_run_prefix + std::to_string(m_runs.size()) + ".run";
+  write_run(filename, run, sorted_rows(run), m_block_size);
+
+  m_runs.emplace_back();
+  auto& spilled = m_runs.back();
+  spilled.filename = filename;
+  spilled.file = std::make_shared<FileUtility>(filename, 0);
+  spilled.block.reset(m_schema, m_block_size);
+}
+
+void SortingReader::create_runs() {
+  m_runs_created = true;
+  bool keep_all = m_range[0] == std::numeric_limits<int64_t>::min() &&
+                  m_range[1] == std::numeric_limits<int64_t>::max();
+  CellBatch batch(m_schema, m_block_size);
+  CellBatch run(m_schema, std::numeric_limits<size_t>::max());
+  while (m_reader->get_next_batch(batch)) {
+    if (keep_all) {
+      run.append_batch(batch);
+    } else {
+      for (auto row = 0u; row < batch.size(); row++) {
+        if (in_range(batch, row)) run.append_row(batch, row);
+      }
+    }
+    // end cells of readers that only implement get_next_cells are sorted like any other cell
+    for (auto& cell : batch.end_cells) {
+      auto key = m_schema->swap_order(cell.coords)[0];
+      if (key >= m_range[0] && key < m_range[1]) run.append_cell(cell);
+    }
+    if (run.size() && run.bytes() >= m_run_bytes) {
+      spill(run);
+      run.clear();
+    }
+  }
+
+  if (run.size() && m_runs.empty() && run.bytes() <= m_resident_bytes) {
+    m_runs.emplace_back();
+    auto& resident = m_runs.back();
+    resident.block.reset(m_schema, run.size());
+    for (auto row : sorted_rows(run)) {
+      resident.block.append_row(run, row);
+    }
+  } else if (run.size()) {
+    spill(run);
+  }
+  logger.debug("Sorted file {} in {} runs", get_filename(), m_runs.size());
+
+  m_merge.reset(m_runs.size());
+  for (auto i = 0u; i < m_runs.size(); i++) {
+    auto& sorted_run = m_runs[i];
+    if (sorted_run.block.size() || load_block(sorted_run)) {
+      m_merge.set_key(i, m_schema->swap_order(sorted_run.block.coords[0]));
+    }
+  }
+  m_merge.rebuild();
+}
+
+bool SortingReader::load_block(SortedRun& run) {
+  run.next = 0;
+  if (run.file && read_run_block(*run.file, m_block_buffer, run.block)) {
+    return true;
+  }
+
+  // the run is exhausted, release its memory and its file
+  run.block = CellBatch();
+  if (run.file) {
+    run.file.reset();
+    FileUtility::delete_file(run.filename);
+  }
+  return false;
+}
+
+bool SortingReader::get_next_batch(CellBatch& batch) {
+  if (!m_runs_created) {
+    create_runs();
+  }
+  batch.clear();
+
+  while (!batch.full() && !m_merge.empty()) {
+    auto& run = m_runs[m_merge.top()];
+    batch.append_row(run.block, run.next);
+    if (++run.next == run.block.size() && !load_block(run)) {
+      m_merge.exhaust();
+    } else {
+      m_merge.update(m_schema->swap_order(run.block.coords[run.next]));
+    }
+  }
+  return batch.size();
+}
+
+OmicsEndCellQueue::~OmicsEndCellQueue() {
+  for (auto& run : m_runs) {
+    if (run.file) {
+      FileUtility::delete_file(run.filename);
+    }
+  }
+}
+
+void OmicsEndCellQueue::reset(std::shared_ptr<OmicsSchema> schema, const std::string& run_prefix,
+                              size_t max_bytes, size_t block_size) {
+  for (auto& run : m_runs) {
+    if (run.file) {
+      FileUtility::delete_file(run.filename);
+    }
+  }
+  m_runs.clear();
+  m_run_heap.clear();
+  m_heap.clear();
+  m_schema = schema;
+  m_run_prefix = run_prefix;
+  m_max_bytes = max_bytes;
+  m_block_size = std::max<size_t>(block_size, 1);
+  m_pending.reset(schema, std::numeric_limits<size_t>::max());
+}
+
+OmicsCell OmicsEndCellQueue::top() {
+  m_top_arena.reset();
+  if (top_in_run()) {
+    auto& run = m_runs[m_run_heap.front()];
+    return run.block.cell(run.next, -1, m_top_arena);
+  }
+  return m_pending.cell(m_heap.front().row, -1, m_top_arena);
+}
+
+void OmicsEndCellQueue::pop() {
+  if (!top_in_run()) {
+    std::pop_heap(m_heap.begin(), m_heap.end(), MarkerGreater());
+    m_heap.pop_back();
+    if (m_heap.empty()) {
+      m_pending.clear();
+    }
+    return;
+  }
+
+  auto greater = [this](size_t l, size_t r) { return run_greater(l, r); };
+  std::pop_heap(m_run_heap.begin(), m_run_heap.end(), greater);
+  auto& run = m_runs[m_run_heap.back()];
+  if (++run.next == run.block.size()) {
+    run.next = 0;
+    if (!read_run_block(*run.file, m_block_buffer, run.block)) {
+      // the run is exhausted, release its memory and its file
+      run.block = CellBatch();
+      run.file.reset();
+      FileUtility::delete_file(run.filename);
+      m_run_heap.pop_back();
+      return;
+    }
+  }
+  std::push_heap(m_run_heap.begin(), m_run_heap.end(), greater);
+}
+
+void OmicsEndCellQueue::push(const CellBatch& batch, size_t row,
+                             const std::array<int64_t, 2>& coords) {
+  m_pending.append_row(batch, row);
+  m_pending.coords.back() = coords;
+  m_pending.end_positions.back() = -1;
+  m_pending.levels.back() = -1;
+  queued();
+}
+
+void OmicsEndCellQueue::push(const OmicsCell& cell) {
+  m_pending.append_cell(cell);
+  queued();
+}
+
+void OmicsEndCellQueue::push_marker(const std::array<int64_t, 2>& coords,
+                                    FieldSlot<int64_t> span_slot,
+                                    const std::array<int64_t, 2>& span) {
+  m_pending.add_cell(coords);
+  size_t row = m_pending.size() - 1;
+  for (size_t i = 0; i < m_pending.data.size(); i++) {
+    if ((int)i == span_slot.idx) {
+      m_pending.append(span_slot, span.data(), span.size());
+    } else if (!m_pending.is_variable(i)) {
+      memset(m_pending.extend(i, m_pending.length(i, row)), 0, m_pending.length(i, row));
+    }
+  }
+  queued();
+}
+
+void OmicsEndCellQueue::queued() {
+  m_heap.push_back({m_pending.coords.back(), m_pending.size() - 1});
+  std::push_heap(m_heap.begin(), m_heap.end(), MarkerGreater());
+
+  size_t bytes = m_max_bytes ? m_pending.bytes() : 0;
+  if (bytes < m_max_bytes) return;
+  // cells that were popped since the last compaction still take room in m_pending
+  if (bytes / m_pending.size() * m_heap.size() > m_max_bytes / 2) {
+    spill();
+  } else {
+    compact();
+  }
+}
+
+void OmicsEndCellQueue::compact() {
+  CellBatch live(m_schema, std::numeric_limits<size_t>::max());
+  for (auto& marker : m_heap) {
+    live.append_row(m_pending, marker.row);
+    marker.row = live.size() - 1;
+  }
+  std::swap(m_pending, live);
+}
+
+void OmicsEndCellQueue::spill() {
+  std::sort(m_heap.begin(), m_heap.end(),
+            [](const Marker& l, const Marker& r) { return l.coords < r.coords; });
+  std::vector<size_t> rows;
+  rows.reserve(m_heap.size());
+  for (auto& marker : m_heap) {
+    rows.push_back(marker.row);
+  }
+
+  m_runs.emplace_back();
+  auto& run = m_runs.back();
+  run.filename = m_run_prefix + std::to_string(m_num_runs++) + ".run";
+  write_run(run.filename, m_pending, rows, m_block_size);
+  logger.debug("Spilled {} end cells to {}", rows.size(), run.filename);
+  m_heap.clear();
+  m_pending.clear();
+
+  run.file = std::make_shared<FileUtility>(run.filename, 0);
+  run.block.reset(m_schema, m_block_size);
+  read_run_block(*run.file, m_block_buffer, run.block);
+  m_run_heap.push_back(m_runs.size() - 1);
+  std::push_heap(m_run_heap.begin(), m_run_heap.end(),
+                 [this](size_t l, size_t r) { return run_greater(l, r); });
+}
+
+void OmicsReaderPool::open() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_peak = std::max(m_peak, ++m_open);
+  if (m_open > m_max_open && !m_warned) {
+    m_warned = true;
+    logger.warn(
+        "More than {} input files overlap and are open at once, their buffers are sized for {} "
+        "files",
+        m_max_open, m_max_open);
+  }
+}
+
+void OmicsReaderPool::close() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_open--;
+}
+
+size_t OmicsReaderPool::peak_open() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_peak;
+}
+
+PooledReader::PooledReader(std::string filename, std::shared_ptr<OmicsSchema> schema,
+                           std::shared_ptr<SampleMap> sample_map, int file_idx, open_t open,
+                           std::shared_ptr<OmicsReaderPool> pool, size_t buffer_size,
+                           bool probe_sample_rows)
+    : OmicsFileReader(filename, schema, sample_map, file_idx, 0),
+      m_open(open),
+      m_pool(pool),
+      m_buffer_size(buffer_size) {
+  if (probe_sample_rows) {
+    // e.g. the sample of a bed file is named in its header
+    m_sample_rows = m_open(std::min<size_t>(buffer_size, 64 * 1024))->sample_rows();
+  }
+}
+
+PooledReader::~PooledReader() {
+  if (m_reader) {
+    m_pool->close();
+  }
+}
+
+bool PooledReader::get_next_batch(CellBatch& batch) {
+  if (m_closed) {
+    batch.clear();
+    return false;
+  }
+  if (!m_reader) {
+    m_reader = m_open(m_buffer_size);
+    m_pool->open();
+  }
+  if (m_reader->get_next_batch(batch)) {
+    return true;
+  }
+
+  // end of file, release the buffers and handles of the reader
+  m_reader.reset();
+  m_pool->close();
+  m_closed = true;
+  return false;
+}
+
+MergingReader::MergingReader(const std::vector<std::shared_ptr<OmicsFileReader>>& readers,
+                             size_t batch_size, int file_idx)
+    : OmicsFileReader(*readers.at(0)),  // named after the first file of the group
+      m_inputs(readers.size()),
+      m_batch_size(batch_size) {
+  m_file_idx = file_idx;
+  for (auto i = 0u; i < readers.size(); i++) {
+    m_inputs[i].reader = readers[i];
+    m_deferred = m_deferred && readers[i]->deferred();
+    auto rows = readers[i]->sample_rows();
+    m_sample_rows[0] = std::min(m_sample_rows[0], rows[0]);
+    m_sample_rows[1] = std::max(m_sample_rows[1], rows[1]);
+  }
+}
+
+void MergingReader::start() {
+  m_started = true;
+  m_merge.reset(m_inputs.size());
+  for (auto i = 0u; i < m_inputs.size(); i++) {
+    auto& input = m_inputs[i];
+    input.batch.reset(m_schema, m_batch_size);
+    if (input.reader->deferred()) {
+      input.deferred = true;
+      m_merge.set_key(i, input.reader->first_coords());
+    } else if (load(i)) {
+      m_merge.set_key(i, m_schema->swap_order(input.batch.coords[0]));
+    }
+  }
+  m_merge.rebuild();
+  open_deferred();
+}
+
+bool MergingReader::load(size_t idx) {
+  auto& input = m_inputs[idx];
+  input.next = 0;
+  while (input.reader->get_next_batch(input.batch)) {
+    for (auto& cell : input.batch.end_cells) {
+      m_end_cells.emplace_back(cell.copy(m_end_cell_arena));
+    }
+    input.batch.end_cells.clear();
+    if (input.batch.size()) {
+      return true;
+    }
+  }
+  // the input is exhausted, release its batch and its reader
+  input.batch = CellBatch();
+  input.reader.reset();
+  return false;
+}
+
+void MergingReader::open_deferred() {
+  while (!m_merge.empty() && m_inputs[m_merge.top()].deferred) {
+    size_t idx = m_merge.top();
+    m_inputs[idx].deferred = false;
+    if (load(idx)) {
+      m_merge.update(m_schema->swap_order(m_inputs[idx].batch.coords[0]));
+    } else {
+      m_merge.exhaust();
+    }
+  }
+}
+
+bool MergingReader::get_next_batch(CellBatch& batch) {
+  if (!m_started) {
+    start();
+  }
+  batch.clear();
+
+  while (!batch.full() && !m_merge.empty()) {
+    size_t idx = m_merge.top();
+    auto& input = m_inputs[idx];
+    batch.append_row(input.batch, input.next);
+    if (++input.next == input.batch.size() && !load(idx)) {
+      m_merge.exhaust();
+    } else {
+      m_merge.update(m_schema->swap_order(input.batch.coords[input.next]));
+    }
+    open_deferred();
+  }
+
+  for (auto& cell : m_end_cells) {
+    batch.end_cells.emplace_back(cell.copy(batch.arena));
+  }
+  m_end_cells.clear();
+  m_end_cell_arena.reset();
+  return !batch.empty();
+}
+
+OmicsReaderPrefetcher::OmicsReaderPrefetcher(
+    const std::vector<std::shared_ptr<OmicsFileReader>>& readers,
+    std::shared_ptr<OmicsSchema> schema, size_t batch_size, size_t num_threads, size_t queue_depth)
+    : m_readers(readers),
+      m_schema(schema),
+      m_batch_size(batch_size),
+      m_queue_depth(std::max<size_t>(queue_depth, 1)),
+      m_queues(readers.size()) {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto i = 0u; i < m_readers.size(); i++) {
+      if (!m_readers[i]) {
+        m_queues[i].end_of_file = true;
+      } else if (!m_readers[i]->deferred()) {
+        schedule(i);
+      }
+    }
+  }
+  for (auto i = 0u; i < std::max<size_t>(num_threads, 1); i++) {
+    m_workers.emplace_back(&OmicsReaderPrefetcher::work, this);
+  }
+}
+
+OmicsReaderPrefetcher::~OmicsReaderPrefetcher() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  m_work_available.notify_all();
+  for (auto& worker : m_workers) {
+    worker.join();
+  }
+}
+
+void OmicsReaderPrefetcher::schedule(size_t idx) {
+  m_queues[idx].scheduled = true;
+  m_ready.push_back(idx);
+  m_work_available.notify_one();
+}
+
+void OmicsReaderPrefetcher::work() {
+  std::vector<CellBatch> batches;
+  while (true) {
+    size_t idx, parsed = 0;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_work_available.wait(lock, [this] { return m_stop || !m_ready.empty(); });
+      if (m_stop) return;
+      idx = m_ready.front();
+      m_ready.pop_front();
+      auto& queue = m_queues[idx];
+      auto space = m_queue_depth - std::min(m_queue_depth, queue.batches.size());
+      for (auto i = 0u; i < space; i++) {
+        if (queue.spare.empty()) {
+          batches.emplace_back(m_schema, m_batch_size);
+        } else {
+          batches.emplace_back(std::move(queue.spare.back()));
+          queue.spare.pop_back();
+        }
+      }
+    }
+
+    // parse outside of the lock, only this worker touches m_readers[idx] while it is scheduled
+    bool end_of_file = false;
+    std::exception_ptr error;
+    try {
+      while (parsed < batches.size() && !end_of_file) {
+        if (m_readers[idx]->get_next_batch(batches[parsed])) {
+          parsed++;
+        } else {
+          end_of_file = true;
+        }
+      }
+    } catch (...) {
+      error = std::current_exception();
+      end_of_file = true;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      auto& queue = m_queues[idx];
+      for (auto i = 0u; i < batches.size(); i++) {
+        if (i < parsed) {
+          queue.batches.emplace_back(std::move(batches[i]));
+        } else {
+          queue.spare.emplace_back(std::move(batches[i]));
+        }
+      }
+      queue.end_of_file = end_of_file;
+      queue.error = error;
+      queue.scheduled = false;
+      if (!end_of_file && queue.batches.size() < m_queue_depth && !m_stop) {
+        schedule(idx);
+      }
+    }
+    batches.clear();
+    m_batches_available.notify_all();
+  }
+}
+
+bool OmicsReaderPrefetcher::get_next_batch(int idx, CellBatch& batch) {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  auto& queue = m_queues[idx];
+  if (!queue.scheduled && !queue.end_of_file && queue.batches.empty()) {
+    schedule(idx);  // deferred until now
+  }
+  m_batches_available.wait(lock,
+                           [&queue] { return !queue.batches.empty() || queue.end_of_file; });
+  if (queue.batches.empty()) {
+    if (queue.error) {
+      std::rethrow_exception(queue.error);
+    }
+    batch.clear();
+    return false;
+  }
+  std::swap(batch, queue.batches.front());
+  queue.spare.emplace_back(std::move(queue.batches.front()));
+  queue.batches.pop_front();
+  if (!queue.scheduled && !queue.end_of_file) {
+    schedule(idx);
+  }
+  return true;
+}
+
+void OmicsReaderPrefetcher::prefetch(int idx) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto& queue = m_queues[idx];
+  if (!queue.scheduled && !queue.end_of_file && queue.batches.empty()) {
+    schedule(idx);
+  }
+}
+
+OmicsBufferWriter::OmicsBufferWriter(std::shared_ptr<OmicsDSArrayStorage> storage,
+                                     size_t num_sets)
+    : m_storage(storage), m_max_sets(std::max<size_t>(num_sets, 2) - 1) {
+  m_thread = std::thread(&OmicsBufferWriter::work, this);
+}
+
+OmicsBufferWriter::~OmicsBufferWriter() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  m_set_submitted.notify_all();
+  m_thread.join();
+}
+
+void OmicsBufferWriter::work() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while (true) {
+    m_set_submitted.wait(lock, [this] { return m_stop || !m_queue.empty(); });
+    if (m_queue.empty()) return;
+    BufferSet set = std::move(m_queue.front());
+    m_queue.pop_front();
+    m_storing = true;
+
+    // store outside of the lock, nothing is stored after an error
+    if (!m_error) {
+      lock.unlock();
+      std::exception_ptr error;
+      try {
+        m_storage->store(set.pointers, set.sizes);
+      } catch (...) {
+        error = std::current_exception();
+      }
+      lock.lock();
+      m_error = error;
+    }
+    m_storing = false;
+    m_stored.emplace_back(std::move(set));
+    m_set_stored.notify_all();
+  }
+}
+
+OmicsBufferWriter::BufferSet OmicsBufferWriter::acquire() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_set_stored.wait(lock,
+                    [this] { return m_error || !m_stored.empty() || m_created < m_max_sets; });
+  if (m_error) {
+    std::rethrow_exception(m_error);
+  }
+  if (m_stored.empty()) {
+    m_created++;
+    return BufferSet();
+  }
+  BufferSet set = std::move(m_stored.back());
+  m_stored.pop_back();
+  return set;
+}
+
+void OmicsBufferWriter::submit(BufferSet&& set) {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_queue.emplace_back(std::move(set));
+  }
+  m_set_submitted.notify_one();
 }
 
-bool MatrixReader::parse_next(std::string& sample, std::string& gene, float& score) {
-  if (m_column_idx >= m_row_scores.size()) {
-    std::string line;
-    if (!m_reader_util->generalized_getline(line)) {
-      logger.debug("*** End of input!!!");
-      return false;
-    }
+void OmicsBufferWriter::wait() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_set_stored.wait(lock, [this] { return m_queue.empty() && !m_storing; });
+  if (m_error) {
+    std::rethrow_exception(m_error);
+  }
+}
 
-    auto toks = split(line, m_token_separator);
-    if (toks.size() != m_columns.size() + 1) {  // sample/gene id followed by scores
-      logger.fatal(OmicsDSException(logger.format("Error with matrix cell values in input, number "
-                                                  "of columns({}) do not match header({})",
-                                                  toks.size() - 1, m_columns.size())),
-                   "Erroneous line from file({}) : \n{}{}", get_filename(), line.substr(0, 60),
-                   line.length() > 59 ? "..." : "");
+void OmicsLoader::size_buffers() {
+  auto num_attributes = m_schema->attributes.size();
+  m_observed_var_bytes.resize(num_attributes, 0);
+  std::vector<uint64_t> var_bytes = m_observed_var_bytes;
+  uint64_t cells = m_observed_cells;
+  if (!cells) {
+    for (auto& lane : m_lanes) {
+      if (!lane.batch.size()) continue;
+      for (auto i = 0u; i < num_attributes; i++) {
+        if (lane.batch.is_variable(i)) var_bytes[i] += lane.batch.var_data[i].size();
+      }
+      cells += lane.batch.size();
     }
+  }
 
-    m_current_token = toks[0];
+  std::vector<double> bytes_per_cell(num_attributes);
+  m_planned_var_bytes.assign(num_attributes, 0);
+  double cell_bytes = 3 * sizeof(uint64_t);  // coords
+  for (auto [i, attribute] = std::tuple{0u, m_schema->attributes.begin()}; i < num_attributes;
+       i++, attribute++) {
+    if (attribute->second.is_variable()) {
+      // leave some slack as the cells of the next write may be larger than the average
+      m_planned_var_bytes[i] = cells ? (double)var_bytes[i] / cells : 0;
+      bytes_per_cell[i] = 1.25 * m_planned_var_bytes[i] + 1;
+      cell_bytes += sizeof(size_t) + bytes_per_cell[i];
+    } else {
+      bytes_per_cell[i] = attribute->second.element_size() * attribute->second.length;
+      cell_bytes += bytes_per_cell[i];
+    }
+  }
 
-    try {
-      for (size_t i = 0; i < m_columns.size(); i++) {
-        m_row_scores[i] = std::stof(toks[i + 1]);
-      }
-    } catch (...) {
-      logger.fatal(
-          OmicsDSException("Error with matrix cell values in input, they have to be numbers"));
+  size_t set_budget = m_memory_budget / std::max<size_t>(m_write_buffer_sets, 1);
+  m_cells_per_write = std::max<size_t>(set_budget / cell_bytes, 1);
+  m_buffer_capacities.resize(num_attributes);
+  m_var_buffer_capacities.resize(num_attributes);
+  for (auto [i, attribute] = std::tuple{0u, m_schema->attributes.begin()}; i < num_attributes;
+       i++, attribute++) {
+    if (attribute->second.is_variable()) {
+      m_buffer_capacities[i] = m_cells_per_write * sizeof(size_t);
+      m_var_buffer_capacities[i] = m_cells_per_write * bytes_per_cell[i];
+    } else {
+      m_buffer_capacities[i] = m_cells_per_write * bytes_per_cell[i];
+      m_var_buffer_capacities[i] = 0;
     }
-    m_column_idx = 0;
   }
+}
 
-  if (m_column_idx == m_row_scores.size()) {
-    return false;
+bool OmicsLoader::left_planned_sizes() const {
+  if (!m_observed_cells) return false;
+  for (auto i = 0u; i < m_planned_var_bytes.size(); i++) {
+    double average = (double)m_observed_var_bytes[i] / m_observed_cells;
+    double planned = m_planned_var_bytes[i];
+    if (average > 1.25 * planned + 1 || 1.25 * average + 1 < planned) return true;
   }
+  return false;
+}
 
-  if (m_id_major) {
-    sample = m_columns[m_column_idx];
-    gene = m_current_token;
-  } else {
-    sample = m_current_token;
-    gene = m_columns[m_column_idx];
+void OmicsLoader::allocate_buffers() {
+  m_buffers.resize(m_schema->attributes.size());
+  m_var_buffers.resize(m_schema->attributes.size());
+  for (auto i = 0u; i < m_schema->attributes.size(); i++) {
+    m_buffers[i].resize(m_buffer_capacities[i]);
+    m_var_buffers[i].resize(m_var_buffer_capacities[i]);
   }
-  score = m_row_scores[m_column_idx];
-  m_column_idx++;
-  return true;
+  m_coords_buffer.resize(3 * m_cells_per_write);
 }
 
-std::vector<OmicsCell> MatrixReader::get_next_cells() {
-  std::string sample_name, gene_name;  // TODO avoid repeated lookups for row token
-  float score;
-  uint64_t row_idx;
-
-  while (parse_next(sample_name, gene_name, score)) {
-    if (m_sample_map->count(sample_name)) {
-      gtf_encoding_t encoded_id = encode_gtf_id(gene_name);
-      logger.debug("Gene={} Encoded ID={:#08x} {:#08x}", gene_name, encoded_id.first,
-                   encoded_id.second);
-      if (encoded_id.first) {
-        row_idx = (*m_sample_map)[sample_name];
-        MatrixCell cell({(int64_t)row_idx, (int64_t)encoded_id.first}, encoded_id.second, m_schema,
-                        m_file_idx);
-        cell.add_field("SCORE", score);
-        cell.add_field("VERSION", encoded_id.second);
-        return {cell};
-      } else {
-        logger.error("Gene name {} cannot be encoded", gene_name);
-      }
-    }
+void OmicsLoader::wait_for_writes() {
+  if (m_writer) {
+    m_writer->wait();
   }
-  return {};
 }
 
 void OmicsLoader::store_buffers() {
+  flush_run();
+
   std::vector<void*> buffers_vec;
   std::vector<size_t> buffer_sizes_vec;
 
@@ -647,7 +1760,21 @@ void OmicsLoader::store_buffers() {
   buffers_vec.push_back(m_coords_buffer.data());
   buffer_sizes_vec.push_back(m_coords_buffer_length * sizeof(size_t));
 
-  m_array_storage->store(buffers_vec, buffer_sizes_vec);
+  if (!m_writer) {
+    m_array_storage->store(buffers_vec, buffer_sizes_vec);
+    return;
+  }
+
+  // hand the filled buffers to the writer and continue with the buffers of a set it has stored,
+  // swapping the vectors leaves the pointers in buffers_vec valid. The buffers of a new set are
+  // allocated by write_buffers
+  OmicsBufferWriter::BufferSet set = m_writer->acquire();
+  std::swap(set.buffers, m_buffers);
+  std::swap(set.var_buffers, m_var_buffers);
+  std::swap(set.coords_buffer, m_coords_buffer);
+  set.pointers = std::move(buffers_vec);
+  set.sizes = std::move(buffer_sizes_vec);
+  m_writer->submit(std::move(set));
 }
 
 static std::string format_number(uint64_t number) {
@@ -672,81 +1799,208 @@ void OmicsLoader::write_buffers() {
   store_buffers();
 
   m_total_processed_cells += m_buffered_cells;
-  logger.info("Processed {}/{} cells", format_number(m_total_processed_cells),
-              format_number(252000000));
-  // Reset buffers' lengths
+  logger.info("Processed {} cells", format_number(m_total_processed_cells));
+  // resize the buffers once the bytes per cell written so far left the slack of their sizes, the
+  // buffers of a set new to the writer are allocated as well. Then reset their lengths
+  m_observed_cells += m_buffered_cells;
   for (auto i = 0u; i < m_schema->attributes.size(); i++) {
+    m_observed_var_bytes[i] += m_var_buffer_lengths[i];
     m_buffer_lengths[i] = 0;
     m_var_buffer_lengths[i] = 0;
   }
+  if (left_planned_sizes()) {
+    size_buffers();
+  }
+  allocate_buffers();
   m_coords_buffer_length = 0;
   m_buffered_cells = 0;
   memset(m_attribute_offsets.data(), 0, m_attribute_offsets.size() * sizeof(size_t));
 }
 
-bool OmicsLoader::check_buffer_sizes(const OmicsCell& cell) {
-  assert(cell.fields.size() == m_schema->attributes.size());
+template <class F>
+bool OmicsLoader::check_buffer_sizes(F field_length) {
   for (auto [i, attribute] = std::tuple{0u, m_schema->attributes.begin()};
        i < m_schema->attributes.size(); i++, attribute++) {
-    auto& field = cell.fields[i].data;
-    size_t size = attribute->second.element_size();
     if (attribute->second.is_variable()) {  // variable length
-      if (m_buffer_lengths[i] + sizeof(size_t) > buffer_size) return false;
-      if (m_var_buffer_lengths[i] + field.size() > buffer_size) return false;
+      if (m_buffer_lengths[i] + sizeof(size_t) > m_buffers[i].size()) return false;
+      if (m_var_buffer_lengths[i] + field_length(i) > m_var_buffers[i].size()) return false;
     } else {
-      if (m_buffer_lengths[i] + field.size() > buffer_size) return false;
+      if (m_buffer_lengths[i] + field_length(i) > m_buffers[i].size()) return false;
     }
   }
-  if (m_coords_buffer_length + 3 * sizeof(uint64_t) > buffer_size) return false;
+  if (m_coords_buffer_length + 3 > m_coords_buffer.size()) return false;
   return true;
 }
 
-void OmicsLoader::buffer_cell(const OmicsCell& cell, int level) {
-  if (!check_buffer_sizes(cell)) {
+template <class F>
+void OmicsLoader::make_room(F field_length) {
+  if (check_buffer_sizes(field_length)) return;
+  if (m_coords_buffer_length) {
     write_buffers();
   }
+  for (auto i = 0u; i < m_schema->attributes.size(); i++) {
+    if (m_var_buffer_capacities[i] && m_var_buffers[i].size() < field_length(i)) {
+      m_var_buffers[i].resize(field_length(i));
+    }
+  }
+}
+
+void OmicsLoader::buffer_cell(const OmicsCell& cell, int level) {
+  assert(cell.num_fields == m_schema->attributes.size());
+  flush_run();
+  make_room([&cell](size_t i) { return cell.fields[i].length; });
 
   for (auto [i, attribute] = std::tuple{0u, m_schema->attributes.begin()};
        i < m_schema->attributes.size(); i++, attribute++) {
-    auto& field = cell.fields[i].data;
+    auto& field = cell.fields[i];
     int length = attribute->second.length;
     size_t size = attribute->second.element_size();
     if (attribute->second.is_variable()) {  // variable length
       memcpy(m_buffers[i].data() + m_buffer_lengths[i], &m_attribute_offsets[i], sizeof(size_t));
-      memcpy(m_var_buffers[i].data() + m_var_buffer_lengths[i], field.data(), field.size());
-      m_attribute_offsets[i] += field.size();
+      if (field.length) {
+        memcpy(m_var_buffers[i].data() + m_var_buffer_lengths[i], field.data, field.length);
+      }
+      m_attribute_offsets[i] += field.length;
       m_buffer_lengths[i] += sizeof(size_t);
-      m_var_buffer_lengths[i] += field.size();
+      m_var_buffer_lengths[i] += field.length;
     } else {
       assert(length >= 0);  // Should only be negative if variable
-      assert(field.size() == size * (size_t)length);
-      memcpy(m_buffers[i].data() + m_buffer_lengths[i], field.data(), field.size());
-      m_buffer_lengths[i] += field.size();
+      assert(field.length == size * (size_t)length);
+      memcpy(m_buffers[i].data() + m_buffer_lengths[i], field.data, field.length);
+      m_buffer_lengths[i] += field.length;
     }
   }
 
-  memcpy(m_coords_buffer.data() + m_coords_buffer_length++, &cell.coords[0], sizeof(uint64_t));
-  memcpy(m_coords_buffer.data() + m_coords_buffer_length++, &cell.coords[1], sizeof(uint64_t));
-  uint64_t this_level = (uint64_t)level;
-  memcpy(m_coords_buffer.data() + m_coords_buffer_length++, &this_level, sizeof(uint64_t));
+  m_coords_buffer[m_coords_buffer_length++] = cell.coords[0];
+  m_coords_buffer[m_coords_buffer_length++] = cell.coords[1];
+  m_coords_buffer[m_coords_buffer_length++] = level;
+}
+
+void OmicsLoader::buffer_row(size_t idx, size_t row, int level) {
+  auto& batch = m_lanes[idx].batch;
+  if (m_run.begin != m_run.end && (m_run.lane != idx || m_run.end != row)) {
+    flush_run();
+  }
+  make_room([&batch, row](size_t i) { return batch.length(i, row); });
+  if (m_run.begin == m_run.end) {
+    m_run.lane = idx;
+    m_run.begin = m_run.end = row;
+    m_run.buffer_start = m_buffer_lengths;
+    m_run.var_buffer_start = m_var_buffer_lengths;
+  }
 
-  bool close_and_reopen_array = less_than(m_pq.top(), cell);
-  if (++m_buffered_cells > 1024 * 1024 * 1 /*1M cells ~320MB for single cell*/ ||
-      close_and_reopen_array) {
-    if (close_and_reopen_array && !m_split_warning_emitted && !m_pq.empty()) {
-      m_split_warning_emitted = true;
-      logger.warn(
-          "Array is being split over multiple fragments. This may cause perfomance penalties "
-          "while querying. Consider consolidating the array after import.");
+  // only account for the attributes here, see flush_run
+  for (auto i = 0u; i < m_buffer_lengths.size(); i++) {
+    if (batch.is_variable(i)) {
+      m_buffer_lengths[i] += sizeof(size_t);
+      m_var_buffer_lengths[i] += batch.length(i, row);
+    } else {
+      m_buffer_lengths[i] += batch.length(i, row);
+    }
+  }
+  m_run.end = row + 1;
+
+  m_coords_buffer[m_coords_buffer_length++] = batch.coords[row][0];
+  m_coords_buffer[m_coords_buffer_length++] = batch.coords[row][1];
+  m_coords_buffer[m_coords_buffer_length++] = level;
+}
+
+size_t OmicsLoader::buffer_rows(size_t idx, std::array<int64_t, 2>& last) {
+  auto& lane = m_lanes[idx];
+  auto& batch = lane.batch;
+  size_t begin = lane.next;
+
+  // the rows up to the next cell of another lane, with ties going to the lane with the lower index,
+  // or the next end cell, which goes first
+  size_t runner_up = m_sequential ? m_merge.size() : m_merge.runner_up();
+  auto before_others = [&](const std::array<int64_t, 2>& coords) {
+    if (runner_up < m_merge.size()) {
+      auto& key = m_merge.key(runner_up);
+      if (less_than(key, coords) || (key == coords && runner_up < idx)) return false;
+    }
+    return m_end_cells.empty() || less_than(coords, m_end_cells.top_coords());
+  };
+  size_t end = begin + 1;
+  while (end < batch.size() && batch.levels[end] >= 0 && in_shard(batch.coords[end]) &&
+         !less_than(batch.coords[end], batch.coords[end - 1]) && before_others(batch.coords[end])) {
+    end++;
+  }
+
+  // as many of them as fit in the buffers
+  auto fit = [&] {
+    size_t rows = (m_coords_buffer.size() - m_coords_buffer_length) / 3;
+    for (auto i = 0u; i < m_buffer_lengths.size(); i++) {
+      rows = std::min(rows, (m_buffers[i].size() - m_buffer_lengths[i]) / batch.length(i, begin));
+    }
+    return rows;
+  };
+  size_t rows = fit();
+  if (!rows) {
+    make_room([&batch, begin](size_t i) { return batch.length(i, begin); });
+    rows = fit();
+  }
+  end = std::min(end, begin + rows);
+
+  if (m_run.begin != m_run.end && (m_run.lane != idx || m_run.end != begin)) {
+    flush_run();
+  }
+  if (m_run.begin == m_run.end) {
+    m_run.lane = idx;
+    m_run.begin = m_run.end = begin;
+    m_run.buffer_start = m_buffer_lengths;
+    m_run.var_buffer_start = m_var_buffer_lengths;
+  }
+  for (auto i = 0u; i < m_buffer_lengths.size(); i++) {
+    m_buffer_lengths[i] += (end - begin) * batch.length(i, begin);
+  }
+  m_run.end = end;
+
+  auto coords = m_coords_buffer.data() + m_coords_buffer_length;
+  for (auto row = begin; row < end; row++) {
+    *coords++ = batch.coords[row][0];
+    *coords++ = batch.coords[row][1];
+    *coords++ = batch.levels[row];
+    m_min_coords[1] = std::min(m_min_coords[1], batch.coords[row][1]);
+    m_max_coords[1] = std::max(m_max_coords[1], batch.coords[row][1]);
+  }
+  m_coords_buffer_length += 3 * (end - begin);
+  m_min_coords[0] = std::min(m_min_coords[0], batch.coords[begin][0]);
+  m_max_coords[0] = std::max(m_max_coords[0], batch.coords[end - 1][0]);
+
+  last = batch.coords[end - 1];
+  lane.next = end - 1;
+  advance_lane();
+  return end - begin;
+}
+
+void OmicsLoader::flush_run() {
+  if (m_run.begin == m_run.end) return;
+
+  auto& batch = m_lanes[m_run.lane].batch;
+  size_t rows = m_run.end - m_run.begin;
+  for (auto i = 0u; i < m_buffer_lengths.size(); i++) {
+    if (batch.is_variable(i)) {
+      size_t first = batch.offsets[i][m_run.begin];
+      size_t last =
+          m_run.end < batch.size() ? batch.offsets[i][m_run.end] : batch.var_data[i].size();
+      auto offsets = m_buffers[i].data() + m_run.buffer_start[i];
+      for (auto row = m_run.begin; row < m_run.end; row++) {
+        size_t offset = m_run.var_buffer_start[i] + batch.offsets[i][row] - first;
+        memcpy(offsets + (row - m_run.begin) * sizeof(size_t), &offset, sizeof(size_t));
+      }
+      memcpy(m_var_buffers[i].data() + m_run.var_buffer_start[i], batch.var_data[i].data() + first,
+             last - first);
+      m_attribute_offsets[i] = m_var_buffer_lengths[i];
+    } else {
+      memcpy(m_buffers[i].data() + m_run.buffer_start[i], batch.field(i, m_run.begin),
+             rows * batch.length(i, m_run.begin));
     }
-    write_buffers();
   }
-  if (close_and_reopen_array) reopen_array();
+  m_run.begin = m_run.end = 0;
 }
 
 void ReadCountLoader::create_schema() {
-  m_schema->attributes.emplace("SAMPLE_NAME",
-                               OmicsFieldInfo(OmicsFieldInfo::OmicsFieldType::omics_char, -1));
+  // the sample of a read is the row of its file in the sample map
   m_schema->attributes.emplace("QNAME",
                                OmicsFieldInfo(OmicsFieldInfo::OmicsFieldType::omics_char, -1));
   m_schema->attributes.emplace("FLAG",
@@ -769,12 +2023,30 @@ void ReadCountLoader::create_schema() {
                                OmicsFieldInfo(OmicsFieldInfo::OmicsFieldType::omics_char, -1));
   m_schema->attributes.emplace("QUAL",
                                OmicsFieldInfo(OmicsFieldInfo::OmicsFieldType::omics_char, -1));
+  m_schema->attributes.emplace("SPAN",
+                               OmicsFieldInfo(OmicsFieldInfo::OmicsFieldType::omics_int64_t, 2));
+}
+
+OmicsCompressionMap ReadCountLoader::default_compression() {
+  auto compression = OmicsLoader::default_compression();
+  for (auto name : {"QNAME", "CIGAR", "SEQ", "QUAL"}) {
+    compression[name] = OmicsCompression(OmicsCompression::ZSTD);
+  }
+  return compression;
 }
 
 void ReadCountLoader::add_reader(const std::string& filename) {
-  if (std::regex_match(filename, std::regex("(.*)(sam)($)"))) {
-    m_files.push_back(
-        std::make_shared<SamReader>(filename, m_schema, m_sample_map, m_files.size()));
+  if (std::regex_match(filename, std::regex("(.*)(sam|bam|cram)($)"))) {
+    int file_idx = m_files.size();
+    add_file(filename, [this, filename, file_idx](size_t) {
+      // shards of position major arrays only read the contigs in their range of indexed files
+      return std::make_shared<SamReader>(
+          filename, m_schema, m_sample_map, file_idx, m_decompression_threads,
+          m_schema->position_major()
+              ? m_shard_range
+              : std::array<int64_t, 2>{std::numeric_limits<int64_t>::min(),
+                                       std::numeric_limits<int64_t>::max()});
+    });
   }
 }
 
@@ -795,12 +2067,43 @@ void TranscriptomicsLoader::create_schema() {
   m_schema->attributes.emplace(
       "NAME", OmicsFieldInfo(OmicsFieldInfo::OmicsFieldType::omics_char,
                              -1));  // Field in bed files, will be N/A for matrix files
+  m_schema->attributes.emplace("SPAN",
+                               OmicsFieldInfo(OmicsFieldInfo::OmicsFieldType::omics_int64_t, 2));
+}
+
+std::shared_ptr<OmicsLoader> ReadCountLoader::create_shard() {
+  return std::make_shared<ReadCountLoader>(m_workspace, m_array, m_file_list, m_sample_map_file,
+                                           m_mapping_file, m_schema->position_major());
+}
+
+bool ReadCountLoader::reads_position_shards() {
+  FileUtility list(m_file_list);
+  std::string filename;
+  while (list.generalized_getline(filename)) {
+    if (!std::regex_match(filename, std::regex("(.*)(bam|cram)($)"))) return false;
+    if (!FileUtility::is_file(filename + ".bai") && !FileUtility::is_file(filename + ".csi") &&
+        !FileUtility::is_file(filename + ".crai")) {
+      return false;
+    }
+  }
+  return true;
+}
+
+std::array<int64_t, 2> ReadCountLoader::sample_rows_from_name(const std::string& filename) {
+  auto toks = split(filename, "/");
+  if (toks.size() && m_sample_map->count(toks.back())) {
+    int64_t row = (*m_sample_map)[toks.back()];
+    return {row, row};
+  }
+  return {0, std::numeric_limits<int64_t>::max()};
 }
 
 void TranscriptomicsLoader::add_reader(const std::string& filename) {
   if (std::regex_match(filename, std::regex("(.*)(bed)($)"))) {
-    m_files.push_back(
-        std::make_shared<BedReader>(filename, m_schema, m_sample_map, m_files.size()));
+    int file_idx = m_files.size();
+    add_file(filename, [this, filename, file_idx](size_t buffer_size) {
+      return std::make_shared<BedReader>(filename, m_schema, m_sample_map, file_idx, buffer_size);
+    });
   }
   //  else if(std::regex_match(filename, std::regex("(.*)(resort)($)"))) {
   // m_files.push_back(std::make_shared<MatrixReader>(filename, m_schema, m_sample_map,
@@ -808,14 +2111,23 @@ void TranscriptomicsLoader::add_reader(const std::string& filename) {
   // }
 }
 
+std::shared_ptr<OmicsLoader> TranscriptomicsLoader::create_shard() {
+  return std::make_shared<TranscriptomicsLoader>(m_workspace, m_array, m_file_list,
+                                                 m_sample_map_file, m_mapping_file, "",
+                                                 m_schema->position_major());
+}
+
 void MatrixLoader::create_schema() {
   m_schema->attributes.emplace("SCORE",
                                OmicsFieldInfo(OmicsFieldInfo::OmicsFieldType::omics_float_t, 1));
 }
 
 void MatrixLoader::add_reader(const std::string& filename) {
-  m_files.push_back(
-      std::make_shared<MatrixReader>(filename, m_schema, m_sample_map, m_files.size()));
+  int file_idx = m_files.size();
+  add_file(filename, [this, filename, file_idx](size_t buffer_size) {
+    return std::make_shared<MatrixReader>(filename, m_schema, m_sample_map, file_idx,
+                                          !m_sort_input, buffer_size);
+  });
 }
 
 GeneIdMap::GeneIdMap(const std::string& gene_map, std::shared_ptr<OmicsSchema> schema,
@@ -849,20 +2161,20 @@ GeneIdMap::GeneIdMap(const std::string& gene_map, std::shared_ptr<OmicsSchema> s
 
 void GeneIdMap::create_from_gtf(const std::string& gene_map, bool use_transcript,
                                 bool drop_version) {
-  std::string str;
+  std::string_view str;
 
   int ind = -1;
 
-  FileUtility file(gene_map);
+  OmicsLineReader lines(std::make_shared<FileUtility>(gene_map));
 
-  while (file.generalized_getline(str)) {
-    if (str[0] == '#') {
+  while (lines.next_line(str)) {
+    if (str.empty() || str[0] == '#') {
       continue;
     }
 
     ++ind;
 
-    std::stringstream ss(str);
+    std::stringstream ss{std::string(str)};
     std::string field;
     std::vector<std::string> fields;
 
@@ -895,9 +2207,9 @@ void GeneIdMap::create_from_gtf(const std::string& gene_map, bool use_transcript
                               ? "transcript_id"
                               : "gene_id";  // FIXME use regex in case strangeness with whitespace
 
-    std::smatch m;
+    std::cmatch m;
     std::regex exp(pattern + "\\s*\"(.*?)\"");
-    std::regex_search(str, m, exp);
+    std::regex_search(str.data(), str.data() + str.size(), m, exp);
 
     if (m.size() < 2) {
       continue;
@@ -1009,130 +2321,786 @@ OmicsLoader::OmicsLoader(const std::string& workspace, const std::string& array,
                          const std::string& file_list, const std::string& sample_map,
                          const std::string& mapping_file, bool position_major)
     : OmicsDSModule(workspace, array, mapping_file, position_major),
+      m_workspace(workspace),
+      m_array(array),
+      m_sample_map_file(sample_map),
+      m_mapping_file(mapping_file),
       m_file_list(file_list),
-      m_sample_map(std::make_shared<SampleMap>(sample_map)),
-      m_pq(comparator) {}
+      m_sample_map(std::make_shared<SampleMap>(sample_map)) {}
+
+OmicsLoader::~OmicsLoader() {
+  if (!m_sort_dir.empty() && !m_is_shard) {
+    // the readers delete the runs they still hold before their directory goes
+    m_prefetcher.reset();
+    m_files.clear();
+    m_shard_loaders.clear();
+    FileUtility::delete_dir(m_sort_dir);
+  }
+}
 
 void OmicsLoader::initialize() {  // FIXME move file reader creation to somewhere virtual
   create_schema();
 
-  m_array_storage->initialize(true, m_schema, true, true);
+  // arrays created before reads and intervals had a SPAN keep full copies of their fields in end
+  // cells, imports that add to them do the same
+  if ((m_append || m_is_shard) && FileUtility::is_file(m_schema_default_path)) {
+    OmicsSchema array_schema;
+    if (array_schema.create_from_file(m_schema_default_path) &&
+        !array_schema.attributes.count("SPAN")) {
+      m_schema->attributes.erase("SPAN");
+    }
+  }
+  m_span = m_schema->slot<int64_t>("SPAN");
+
+  // buffer_rows sizes and copies the rows of a batch by the lengths of its first row
+  if (m_bulk_rows) {
+    for (auto& [name, info] : m_schema->attributes) {
+      if (info.is_variable()) {
+        logger.fatal(OmicsDSException(logger.format(
+            "Cannot merge the rows of array {} a batch at a time, attribute {} is variable length",
+            m_array, name)));
+      }
+    }
+  }
 
-  // set up buffers
-  m_buffers = std::vector<std::vector<uint8_t>>(m_schema->attributes.size());
-  m_var_buffers = std::vector<std::vector<uint8_t>>(m_schema->attributes.size());
-  m_attribute_offsets = std::vector<size_t>(m_schema->attributes.size(), 0);
+  // appends add fragments to the array, so the files must match the schema it was created with
+  bool append = m_append && !m_is_shard && FileUtility::is_file(m_schema_default_path);
+  if (append) {
+    OmicsSchema array_schema;
+    if (!array_schema.create_from_file(m_schema_default_path) ||
+        !equivalent_schema(array_schema, *m_schema) || array_schema.order != m_schema->order ||
+        array_schema.genomic_map.contig_boundaries() !=
+            m_schema->genomic_map.contig_boundaries()) {
+      logger.fatal(OmicsDSException(
+          logger.format("Cannot append to array {}, the import does not match the schema at {}",
+                        m_array, m_schema_default_path)));
+    }
+    logger.info("Appending to array {}", m_array);
+  }
 
-  for (auto i = 0u; i < m_schema->attributes.size(); i++) {
-    m_buffers[i].resize(buffer_size);
-    m_var_buffers[i].resize(buffer_size);
+  auto compression = default_compression();
+  for (auto& [name, value] : m_compression) {
+    if (!m_schema->attributes.count(name) && name != OmicsCompressionNames::COORDS &&
+        name != OmicsCompressionNames::OFFSETS) {
+      logger.warn("Compression of {} is ignored, it is not an attribute of the array", name);
+    }
+    compression[name] = value;
   }
-  m_coords_buffer.resize(3 * buffer_size);
+  m_array_storage->set_compression(compression);
+  m_array_storage->set_layout(plan_layout());
+
+  // shards write into the array set up by the loader that split the import
+  bool overwrite = !m_append && !m_is_shard;
+  m_array_storage->initialize(true, m_schema, overwrite, overwrite);
+
+  // set up buffers, sized once the first batches of the files are in
+  m_attribute_offsets = std::vector<size_t>(m_schema->attributes.size(), 0);
   m_buffer_lengths.resize(m_schema->attributes.size(), 0);
   m_var_buffer_lengths.resize(m_schema->attributes.size(), 0);
   m_coords_buffer_length = 0;
 
-  serialize_schema();
+  if (!m_is_shard && !append) {
+    serialize_schema();
+  }
+
+  if (m_sort_input && !m_is_shard) {
+    // runs of the sorted files are spilled next to the array
+    m_sort_dir = FileUtility::append(m_workspace, "." + m_array + "_sort");
+    m_sort_prefix = FileUtility::slashify(m_sort_dir);
+    if (FileUtility::is_dir(m_sort_dir)) {
+      FileUtility::delete_dir(m_sort_dir);
+    }
+    if (FileUtility::create_dir(m_sort_dir)) {
+      logger.fatal(OmicsDSException(
+          logger.format("Could not create directory {} for sorting the input", m_sort_dir)));
+    }
+  }
+
+  if (!m_is_shard) {
+    m_end_cell_prefix = FileUtility::append(m_workspace, "." + m_array + "_end_cells_");
+  }
+
+  if (m_shards > 1 && !m_is_shard) {
+    auto boundaries = shard_boundaries(m_shards);
+    size_t num_shards = boundaries.size() > 2 ? boundaries.size() - 1 : 0;
+    for (auto i = 0u; i < num_shards; i++) {
+      auto shard = create_shard();
+      if (!shard) {
+        m_shard_loaders.clear();
+        break;
+      }
+      // the threads and memory of the import are divided between the shards
+      shard->m_is_shard = true;
+      shard->m_shard_range = {boundaries[i], boundaries[i + 1]};
+      shard->m_append = m_append;
+      shard->m_parse_threads = m_parse_threads / num_shards;
+      shard->m_write_buffer_sets = m_write_buffer_sets;
+      shard->m_memory_budget = m_memory_budget / num_shards;
+      shard->m_max_open_files = std::max<size_t>(m_max_open_files / num_shards, 1);
+      shard->m_merge_fan_in = m_merge_fan_in;
+      shard->m_presorted_files = m_presorted_files;
+      shard->m_decompression_threads = m_decompression_threads;
+      shard->m_batch_size = m_batch_size;
+      shard->m_sort_input = m_sort_input;
+      shard->m_sort_dir = m_sort_dir;
+      shard->m_sort_prefix = m_sort_prefix + "shard" + std::to_string(i) + "_";
+      shard->m_end_cell_prefix = m_end_cell_prefix + "shard" + std::to_string(i) + "_";
+      m_shard_loaders.push_back(shard);
+    }
+    if (!m_shard_loaders.empty()) {
+      logger.info("Importing {} shards in parallel", m_shard_loaders.size());
+      return;  // the shards read the files
+    }
+    logger.warn("Cannot split the import into {} shards, importing on a single thread", m_shards);
+  }
 
-  // add file readers
+  // add file readers, with more files than can be open at once they are opened as the merge reaches
+  // them. The memory budget caps the buffers of the readers open at once as well
+  std::vector<std::string> filenames;
   FileUtility list(m_file_list);
   std::string filename;
   while (list.generalized_getline(filename)) {
     if (FileUtility::is_file(filename)) {
-      add_reader(filename);
+      filenames.push_back(filename);
+    }
+  }
+  size_t open_files = std::max<size_t>(std::min(filenames.size(), m_max_open_files), 1);
+  m_reader_buffer_size = std::clamp<size_t>(m_memory_budget / open_files, 64 * 1024,
+                                            FileUtility::default_buffer_size);
+  if (filenames.size() > m_max_open_files) {
+    m_reader_pool = std::make_shared<OmicsReaderPool>(m_max_open_files);
+    logger.info("Opening {} files as they are merged with {}B buffers", filenames.size(),
+                format_number(m_reader_buffer_size));
+  }
+  for (auto& filename : filenames) {
+    add_reader(filename);
+  }
+
+  // the levels of the reads and intervals at the same coordinates are numbered by the import from
+  // 0, so appends cannot add to the samples that are in the array already. Their files hold a
+  // single sample each
+  if (!m_bulk_rows) {
+    auto array_rows = m_append ? m_array_metadata->sample_rows() : std::vector<uint64_t>();
+    for (auto& file : m_files) {
+      if (!file) continue;
+      auto rows = file->sample_rows();
+      if (rows[0] != rows[1]) continue;
+      if (std::binary_search(array_rows.begin(), array_rows.end(), (uint64_t)rows[0])) {
+        logger.fatal(OmicsDSException(logger.format(
+            "Cannot append {} to array {}, its sample row {} is in the array already",
+            file->get_filename(), m_array, rows[0])));
+      }
+      m_sample_rows.push_back(rows[0]);
+    }
+  }
+
+  if (m_sort_input) {
+    // runs are created by the threads parsing the files, the files that fit are kept in memory
+    size_t num_files = std::count_if(m_files.begin(), m_files.end(),
+                                     [](const omics_fptr& file) { return file != nullptr; });
+    size_t run_bytes = m_memory_budget / std::max<size_t>(m_parse_threads, 1);
+    size_t resident_bytes = m_memory_budget / std::max<size_t>(num_files, 1);
+    for (auto idx = 0u; idx < m_files.size(); idx++) {
+      if (!m_files[idx]) continue;
+      m_files[idx] = std::make_shared<SortingReader>(
+          m_files[idx], m_sort_prefix + std::to_string(idx) + "_", run_bytes, resident_bytes,
+          m_batch_size, m_shard_range);
+    }
+    logger.info("Sorting {} files in runs of up to {}B", num_files, format_number(run_bytes));
+  }
+
+  order_disjoint_files();
+
+  if (m_merge_fan_in > 1 && !m_sequential) {
+    // merge groups of files, and groups of groups, until no merge is wider than the fan-in
+    size_t levels = 1;
+    auto num_files = [this] {
+      return std::count_if(m_files.begin(), m_files.end(),
+                           [](const omics_fptr& file) { return file != nullptr; });
+    };
+    while ((size_t)num_files() > m_merge_fan_in) {
+      std::vector<omics_fptr> groups, group;
+      for (auto& file : m_files) {
+        if (file) group.push_back(file);
+        if (group.size() == m_merge_fan_in || (&file == &m_files.back() && group.size() > 1)) {
+          groups.push_back(std::make_shared<MergingReader>(group, m_batch_size, groups.size()));
+          group.clear();
+        }
+      }
+      groups.insert(groups.end(), group.begin(), group.end());  // a file left over on its own
+      m_files = std::move(groups);
+      levels++;
     }
+    logger.info("Merging the files in {} levels of up to {} files", levels, m_merge_fan_in);
+  }
+
+  if (m_parse_threads) {
+    logger.info("Parsing {} files with {} threads", m_files.size(), m_parse_threads);
+    m_prefetcher = std::make_unique<OmicsReaderPrefetcher>(m_files, m_schema, m_batch_size,
+                                                           m_parse_threads);
   }
 
+  if (m_write_buffer_sets > 1) {
+    logger.info("Writing behind the merge with {} buffer sets", m_write_buffer_sets);
+    m_writer = std::make_unique<OmicsBufferWriter>(m_array_storage, m_write_buffer_sets);
+  }
+
+  m_end_cells.reset(m_schema, m_end_cell_prefix, m_memory_budget / 4, m_batch_size);
   // push first cells from all files
   push_from_all_files();
+
+  size_buffers();
+  allocate_buffers();
+  logger.info("Writing up to {} cells at a time with a memory budget of {}B", m_cells_per_write,
+              format_number(m_memory_budget));
 }
 
-void OmicsLoader::push_from_all_files() {
-  for (auto& f : m_files) {
-    if (!f) continue;
+void OmicsLoader::order_disjoint_files() {
+  m_sequential = false;
+  m_lane_order.clear();
+  for (auto idx = 0u; idx < m_files.size(); idx++) {
+    if (m_files[idx]) m_lane_order.push_back(idx);
+  }
+
+  if (!m_presorted_files) {
+    // the files of a sample major import are disjoint if the samples they cover are
+    if (m_schema->position_major()) return;
+    std::vector<std::array<int64_t, 2>> rows(m_files.size());
+    for (auto idx : m_lane_order) {
+      rows[idx] = m_files[idx]->sample_rows();
+      if (rows[idx][1] == std::numeric_limits<int64_t>::max()) return;  // unknown
+    }
+    std::stable_sort(m_lane_order.begin(), m_lane_order.end(),
+                     [&rows](size_t a, size_t b) { return rows[a][0] < rows[b][0]; });
+    for (auto i = 1u; i < m_lane_order.size(); i++) {
+      if (rows[m_lane_order[i]][0] <= rows[m_lane_order[i - 1]][1]) return;
+    }
+  }
+  // a hint that is wrong is caught by merge_files as unsorted input
+  m_sequential = true;
+  logger.info("Streaming {} files one after the other, their cells do not overlap",
+              m_lane_order.size());
+}
 
-    auto cells = f->get_next_cells();
-    for (auto& c : cells) {
-      if (OmicsCell::is_invalid_cell(c)) continue;
-      c.coords = m_schema->swap_order(c.coords);  // to schema order
-      logger.debug("1 Cell coords {:#08x} {:#08x} from file {}", c.coords[0], c.coords[1],
-                   f->get_filename());
-      m_pq.push(c);
+std::vector<int64_t> OmicsLoader::shard_boundaries(size_t n) {
+  std::vector<int64_t> boundaries;
+  if (m_schema->position_major()) {
+    // split the flattened positions evenly, moving boundaries that are close to the start of a
+    // contig there so that small contigs are not split
+    auto contigs = m_schema->genomic_map.contig_boundaries();
+    if (contigs.size() < 2) return {};
+    double width = (double)(contigs.back() - contigs.front()) / n;
+    boundaries.push_back(contigs.front());
+    for (auto i = 1u; i < n; i++) {
+      uint64_t boundary = contigs.front() + i * width;
+      auto next = std::lower_bound(contigs.begin(), contigs.end(), boundary);
+      auto prev = next == contigs.begin() ? next : std::prev(next);
+      auto nearest = (*next - boundary < boundary - *prev) ? *next : *prev;
+      if (std::abs((double)nearest - (double)boundary) <= width / 4) {
+        boundary = nearest;
+      }
+      if ((int64_t)boundary > boundaries.back()) {
+        boundaries.push_back(boundary);
+      }
+    }
+    if ((int64_t)contigs.back() > boundaries.back()) {
+      boundaries.push_back(contigs.back());
+    }
+  } else {
+    // split the rows of the sample map evenly
+    if (!m_sample_map->size()) return {};
+    size_t first = std::numeric_limits<size_t>::max(), last = 0;
+    for (auto& [name, row] : m_sample_map->map) {
+      first = std::min(first, row);
+      last = std::max(last, row);
+    }
+    size_t rows = last - first + 1;
+    for (auto i = 0u; i <= n; i++) {
+      int64_t boundary = first + rows * i / n;
+      if (boundaries.empty() || boundary > boundaries.back()) {
+        boundaries.push_back(boundary);
+      }
     }
   }
+  // cells outside of the domain belong to the first or last shard
+  boundaries.front() = std::numeric_limits<int64_t>::min();
+  boundaries.back() = std::numeric_limits<int64_t>::max();
+  return boundaries;
 }
 
-void OmicsLoader::push_from_idxs(const std::set<int>& idxs) {
-  for (auto& idx : idxs) {
-    if (idx < 0) continue;
+bool OmicsLoader::import_shards() {
+  if (m_shard_loaders.empty()) return false;
+
+  std::vector<std::exception_ptr> errors(m_shard_loaders.size());
+  std::vector<std::thread> threads;
+  for (auto i = 0u; i < m_shard_loaders.size(); i++) {
+    threads.emplace_back([this, i, &errors] {
+      auto& shard = m_shard_loaders[i];
+      try {
+        shard->initialize();
+        shard->merge_files();
+        if (shard->m_coords_buffer_length) {
+          shard->write_buffers();
+        }
+        shard->wait_for_writes();
+      } catch (...) {
+        errors[i] = std::current_exception();
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  for (auto& shard : m_shard_loaders) {
+    m_total_processed_cells += shard->m_total_processed_cells;
+    m_sample_rows.insert(m_sample_rows.end(), shard->m_sample_rows.begin(),
+                         shard->m_sample_rows.end());
+    for (auto i = 0u; i < m_min_coords.size(); i++) {
+      m_min_coords[i] = std::min(m_min_coords[i], shard->m_min_coords[i]);
+      m_max_coords[i] = std::max(m_max_coords[i], shard->m_max_coords[i]);
+    }
+  }
+  m_shard_loaders.clear();  // finalizes the fragments of the shards
+  for (auto& error : errors) {
+    if (error) std::rethrow_exception(error);
+  }
+  logger.info("Imported {} cells into a fragment per shard, consider consolidating the array",
+              format_number(m_total_processed_cells));
+  return true;
+}
 
-    auto cells = m_files[idx]->get_next_cells();
-    for (auto& c : cells) {
-      if (OmicsCell::is_invalid_cell(c)) continue;
-      c.coords = m_schema->swap_order(c.coords);  // to schema order
-      logger.debug("2 Cell coords {:#08x} {:#08x} from file {}", c.coords[0], c.coords[1], idx);
-      m_pq.push(c);
+void OmicsLoader::configure(const OmicsDSImportConfig& config) {
+  if (config.parse_threads) {
+    m_parse_threads = *config.parse_threads;
+  }
+  if (config.write_buffer_sets) {
+    m_write_buffer_sets = *config.write_buffer_sets;
+  }
+  if (config.memory_budget) {
+    m_memory_budget = *config.memory_budget;
+  }
+  if (config.shards) {
+    m_shards = *config.shards;
+    if (m_shards > 1 && m_schema->position_major() && !reads_position_shards()) {
+      logger.fatal(OmicsDSException(logger.format(
+          "Cannot import array {} in {} shards, the shards of position major arrays would all "
+          "parse every file. Only sample major arrays and indexed BAM or CRAM files are sharded",
+          m_array, m_shards)));
     }
   }
+  if (config.max_open_files) {
+    m_max_open_files = std::max<size_t>(*config.max_open_files, 1);
+  }
+  if (config.merge_fan_in) {
+    m_merge_fan_in = *config.merge_fan_in;
+  }
+  if (config.decompression_threads) {
+    m_decompression_threads = *config.decompression_threads;
+  }
+  if (config.compression && !parse_compression(*config.compression, m_compression)) {
+    logger.fatal(OmicsDSException(logger.format(
+        "Invalid compression {}, expected comma separated name=codec[:level][+delta] entries",
+        *config.compression)));
+  }
+  m_append = config.append;
+  m_sort_input = config.sort_input;
+  m_presorted_files = config.presorted_files;
 }
 
-void OmicsLoader::push_file_from_cell(const OmicsCell& cell) { push_from_idxs({cell.file_idx}); }
+OmicsCompressionMap OmicsLoader::default_compression() {
+  // coordinates and offsets mostly increase from cell to cell
+  OmicsCompressionMap compression = {
+      {OmicsCompressionNames::COORDS, OmicsCompression(OmicsCompression::ZSTD, 0, true)},
+      {OmicsCompressionNames::OFFSETS, OmicsCompression(OmicsCompression::ZSTD, 0, true)}};
+  for (auto& [name, _] : m_schema->attributes) {
+    compression[name] = OmicsCompression(OmicsCompression::LZ4);
+  }
+  return compression;
+}
 
-void OmicsLoader::import() {
-  std::cout << "OmicsLoader::import" << std::endl;
+OmicsArrayLayout OmicsLoader::plan_layout() {
+  OmicsArrayLayout layout;
+  // flattened positions end with the last contig, sample rows stay within int32 so that appends
+  // can add samples
+  auto boundaries = m_schema->genomic_map.contig_boundaries();
+  std::array<int64_t, 2> positions = {0, std::numeric_limits<int64_t>::max()};
+  if (!boundaries.empty()) positions[1] = boundaries.back();
+  std::array<int64_t, 2> samples = {0, std::numeric_limits<int32_t>::max()};
+  auto [rows, cols] = m_schema->position_major() ? std::tuple{positions, samples}
+                                                 : std::tuple{samples, positions};
+  std::copy(rows.begin(), rows.end(), layout.domain.begin());
+  std::copy(cols.begin(), cols.end(), layout.domain.begin() + 2);
+
+  // data tiles of about 1MB, variable length fields are counted as their offset and 16 elements.
+  // The cells are written in row major order, which regular tiles of sparse arrays would break
+  size_t cell_bytes = 3 * sizeof(int64_t);
+  for (auto& [_, info] : m_schema->attributes) {
+    cell_bytes += info.is_variable() ? sizeof(size_t) + 16 * info.element_size()
+                                     : info.length * info.element_size();
+  }
+  layout.capacity = std::clamp<int64_t>((1 << 20) / cell_bytes / 1024 * 1024, 1024, 1 << 20);
+  return layout;
+}
 
-  std::cout << "REMOVE beginning m_pq.size() is " << m_pq.size() << std::endl;
+void OmicsLoader::add_file(const std::string& filename, PooledReader::open_t open) {
+  // files of samples outside the range of a sample major shard have no cells for it, their rows are
+  // probed with a small buffer if the name does not tell them
+  if (m_is_shard && !m_schema->position_major()) {
+    auto rows = sample_rows_from_name(filename);
+    if (rows[1] == std::numeric_limits<int64_t>::max()) {
+      rows = open(std::min<size_t>(m_reader_buffer_size, 64 * 1024))->sample_rows();
+    }
+    if (rows[1] < m_shard_range[0] || rows[0] >= m_shard_range[1]) {
+      m_files.push_back(nullptr);
+      return;
+    }
+  }
+  if (!m_reader_pool) {
+    m_files.push_back(open(m_reader_buffer_size));
+    return;
+  }
+  // the sample rows key the file in sample major merges before it is opened, and are recorded for
+  // the appends to arrays of reads and intervals
+  m_files.push_back(std::make_shared<PooledReader>(filename, m_schema, m_sample_map, m_files.size(),
+                                                   open, m_reader_pool, m_reader_buffer_size,
+                                                   !m_schema->position_major() || !m_bulk_rows));
+}
 
-  std::array<int64_t, 2> last_coords = {-1, -1};
-  int level = 0;
+bool OmicsLoader::get_next_batch(size_t idx, CellBatch& batch) {
+  if (m_prefetcher) {
+    return m_prefetcher->get_next_batch(idx, batch);
+  }
+  return m_files[idx]->get_next_batch(batch);
+}
 
-  while (m_pq.size()) {
-    auto cell = m_pq.top();
-    std::cout << "\t\t\tREMOVE top coords are " << container_to_string(m_pq.top().coords)
-              << std::endl;
-    m_pq.pop();
-    push_file_from_cell(cell);  // make sure that all files are still represented in pq
+bool OmicsLoader::load_batch(size_t idx) {
+  auto& lane = m_lanes[idx];
+  lane.next = 0;
+  while (get_next_batch(idx, lane.batch)) {
+    assert(lane.batch.validate());
+    for (auto& coords : lane.batch.coords) {
+      coords = m_schema->swap_order(coords);  // to schema order
+    }
+    for (auto& cell : lane.batch.end_cells) {
+      auto coords = m_schema->swap_order(cell.coords);
+      if (!in_shard(coords)) continue;
+      OmicsCell end_cell = cell;
+      end_cell.coords = coords;
+      m_end_cells.push(end_cell);  // copied, outlives the batch
+    }
+    lane.batch.end_cells.clear();
+    if (lane.batch.size()) {
+      logger.debug("Batch of {} cells from file {} starting at {:#08x} {:#08x}", lane.batch.size(),
+                   idx, lane.batch.coords[0][0], lane.batch.coords[0][1]);
+      return true;
+    }
+  }
+  return false;
+}
 
-    if (cell.coords[0] < 0 || cell.coords[1] < 0) {  // invalid cell
-      continue;
+void OmicsLoader::push_from_all_files() {
+  m_lanes.resize(m_files.size());
+  if (m_sequential) {
+    m_order_pos = 0;
+    next_sequential_lane();
+    return;
+  }
+  m_merge.reset(m_files.size());
+  for (auto idx = 0u; idx < m_files.size(); idx++) {
+    if (!m_files[idx]) continue;
+
+    m_lanes[idx].batch.reset(m_schema, m_batch_size);
+    if (m_files[idx]->deferred()) {
+      m_lanes[idx].deferred = true;
+      m_merge.set_key(idx, m_files[idx]->first_coords());
+    } else if (load_batch(idx)) {
+      m_merge.set_key(idx, m_lanes[idx].batch.coords[0]);
     }
+  }
+  m_merge.rebuild();
+  open_deferred_lanes();
+}
 
-    if (less_than(m_pq.top(), cell)) {
-      std::cerr << "Error, top of priority queue is less than previous cell" << std::endl;
-      std::cerr << "prev: " << container_to_string(cell.coords) << std::endl;
-      std::cerr << "top: " << container_to_string(m_pq.top().coords) << std::endl;
-      exit(1);
+void OmicsLoader::next_sequential_lane() {
+  for (; m_order_pos < m_lane_order.size(); m_order_pos++) {
+    size_t idx = m_lane_order[m_order_pos];
+    auto& lane = m_lanes[idx];
+    if (m_order_pos && !lane.batch.schema) {
+      // only one file is read at a time, so the batch of the previous one is passed on
+      std::swap(lane.batch, m_lanes[m_lane_order[m_order_pos - 1]].batch);
+    }
+    if (!lane.batch.schema) {
+      lane.batch.reset(m_schema, m_batch_size);
     }
+    if (m_prefetcher && m_order_pos + 1 < m_lane_order.size()) {
+      m_prefetcher->prefetch(m_lane_order[m_order_pos + 1]);  // parsed while this file is merged
+    }
+    if (load_batch(idx)) return;
+  }
+}
+
+void OmicsLoader::exhaust_lane() {
+  if (!m_sequential) {
+    m_merge.exhaust();
+    open_deferred_lanes();
+    return;
+  }
+  if (m_run.lane == top_lane()) {
+    flush_run();  // the batch is handed on to the next file
+  }
+  m_order_pos++;
+  next_sequential_lane();
+}
 
-    if (cell.coords == last_coords) {
-      level++;
+void OmicsLoader::open_deferred_lanes() {
+  while (!m_merge.empty() && m_lanes[m_merge.top()].deferred) {
+    size_t idx = m_merge.top();
+    m_lanes[idx].deferred = false;
+    if (load_batch(idx)) {
+      m_merge.update(m_lanes[idx].batch.coords[0]);
     } else {
-      level = 0;
-      last_coords = cell.coords;
+      m_merge.exhaust();
     }
+  }
+}
 
-    // Buffer cell. Persist to storage if number of cells has passed threshold and clear buffers.
-    buffer_cell(cell, level);
+void OmicsLoader::advance_lane() {
+  size_t idx = top_lane();
+  auto& lane = m_lanes[idx];
+  if (++lane.next == lane.batch.size()) {
+    if (m_run.lane == idx) {
+      flush_run();  // the run refers to rows of the batch about to be replaced
+    }
+    if (!load_batch(idx)) {
+      exhaust_lane();
+      return;
+    }
+  }
+  if (m_sequential) return;
+  m_merge.update(lane.batch.coords[lane.next]);
+  open_deferred_lanes();
+}
+
+int OmicsLoader::next_level(const std::array<int64_t, 2>& coords) {
+  if (coords == m_last_coords) {
+    m_level++;
+  } else {
+    m_level = 0;
+    m_last_coords = coords;
+  }
+  return m_level;
+}
+
+void OmicsLoader::merge_files() {
+  // index of the position in schema order coords
+  int position_idx = m_schema->position_major() ? 0 : 1;
+
+  while (!merge_empty()) {
+    std::array<int64_t, 2> coords;
+    size_t cells = 1;
+    if (next_is_end_cell()) {
+      OmicsCell cell = m_end_cells.top();
+      coords = cell.coords;
+      buffer_cell(cell, next_level(coords));
+      m_end_cells.pop();
+    } else {
+      size_t idx = top_lane();
+      auto& batch = m_lanes[idx].batch;
+      size_t row = m_lanes[idx].next;
+      coords = batch.coords[row];
+      if (coords[0] >= m_shard_range[1] && !m_split_unsorted_input) {
+        // the rest of the file is past the shard, and so are the end cells of its intervals
+        exhaust_lane();
+        continue;
+      }
+      bool buffered = in_shard(coords);
+      if (buffered && m_bulk_rows && batch.levels[row] >= 0) {
+        cells = buffer_rows(idx, coords);  // advances the lane past the rows
+      } else {
+        if (buffered) {
+          buffer_row(idx, row, batch.levels[row] < 0 ? next_level(coords) : batch.levels[row]);
+        }
+        if (batch.end_positions[row] >= 0) {
+          auto end_coords = coords;
+          end_coords[position_idx] = batch.end_positions[row];
+          if (in_shard(end_coords)) {
+            if (!m_span.valid()) {
+              m_end_cells.push(batch, row, end_coords);
+            } else if (end_coords != coords) {
+              // the fields of the read or interval are only stored with its start
+              m_end_cells.push_marker(end_coords, m_span,
+                                      {coords[position_idx], batch.end_positions[row]});
+            }
+          }
+        }
+        advance_lane();
+      }
+      if (!buffered) continue;  // belongs to another shard
+    }
+
+    for (auto i = 0u; i < coords.size(); i++) {
+      m_min_coords[i] = std::min(m_min_coords[i], coords[i]);
+      m_max_coords[i] = std::max(m_max_coords[i], coords[i]);
+    }
+
+    bool close_and_reopen_array = !merge_empty() && less_than(peek_coords(), coords);
+    if (close_and_reopen_array && !m_split_unsorted_input) {
+      std::cerr << "Error, next cell in merge is less than previous cell" << std::endl;
+      std::cerr << "prev: " << container_to_string(coords) << std::endl;
+      std::cerr << "next: " << container_to_string(peek_coords()) << std::endl;
+      std::cerr << "Unsorted input files can be sorted during the import with --sort-input"
+                << std::endl;
+      exit(1);
+    }
+
+    // Persist to storage before the array is split, full buffers are written by make_room
+    m_buffered_cells += cells;
+    if (close_and_reopen_array) {
+      if (!m_split_warning_emitted) {
+        m_split_warning_emitted = true;
+        logger.warn(
+            "Array is being split over multiple fragments. This may cause perfomance penalties "
+            "while querying. Consider consolidating the array after import.");
+      }
+      write_buffers();
+      wait_for_writes();
+      reopen_array();
+    }
+  }
+  m_prefetcher.reset();
+  if (m_end_cells.num_runs()) {
+    logger.info("Spilled end cells far from their starts to {} runs", m_end_cells.num_runs());
+  }
+  if (m_reader_pool) {
+    logger.info("At most {} of {} files were open at once", m_reader_pool->peak_open(),
+                m_files.size());
+  }
+}
+
+void OmicsLoader::import() {
+  logger.info("Starting import...");
+  if (!import_shards()) {
+    merge_files();
+    // Persist remaining cells in buffers.
+    store_buffers();
+    wait_for_writes();
+  }
+
+  if (!m_bulk_rows) {
+    auto rows = m_append ? m_array_metadata->sample_rows() : std::vector<uint64_t>();
+    rows.insert(rows.end(), m_sample_rows.begin(), m_sample_rows.end());
+    m_array_metadata->set_sample_rows(rows);
   }
-  // Persist remaining cells in buffers.
-  store_buffers();
 }
 
 void MatrixLoader::import() {
   logger.info("Starting import...");
-  while (m_pq.size()) {
-    auto cell = m_pq.top();
-    m_pq.pop();
-    push_file_from_cell(cell);
-    MatrixCell* matrix_cell = (MatrixCell*)&cell;
-    expand_extent(Dimension::SAMPLE, matrix_cell->coords[1]);
-    expand_extent(Dimension::FEATURE, matrix_cell->coords[0]);
-    buffer_cell(cell, matrix_cell->get_version());
-  }
-  write_buffers();
+  if (m_dense) {
+    merge_dense();
+  } else if (!import_shards()) {
+    merge_files();
+    write_buffers();
+    wait_for_writes();
+  }
+  if (m_max_coords[0] >= 0) {
+    expand_extent(Dimension::SAMPLE, m_min_coords[1]);
+    expand_extent(Dimension::SAMPLE, m_max_coords[1]);
+    expand_extent(Dimension::FEATURE, m_min_coords[0]);
+    expand_extent(Dimension::FEATURE, m_max_coords[0]);
+  }
+  m_array_metadata->set_dense(m_dense, m_dense_features);
   logger.info("Import DONE");
 }
 
+void MatrixLoader::configure(const OmicsDSImportConfig& config) {
+  OmicsLoader::configure(config);
+  m_dense = config.dense;
+  // the features of a dense array are indexed by the import that created it
+  if (m_append && FileUtility::is_file(m_schema_default_path) &&
+      (m_dense || m_array_metadata->is_dense())) {
+    logger.fatal(OmicsDSException(
+        logger.format("Cannot append to array {}, dense arrays are written by a single import",
+                      m_array)));
+  }
+  if (!m_dense) return;
+
+  m_dense_samples = 1;
+  for (auto& [_, row] : m_sample_map->map) {
+    m_dense_samples = std::max<int64_t>(m_dense_samples, row + 1);
+  }
+}
+
+OmicsArrayLayout MatrixLoader::plan_layout() {
+  auto layout = OmicsLoader::plan_layout();
+  if (!m_dense) return layout;
+
+  // tiles hold all the samples of about 64K cells worth of features
+  int64_t feature_extent = std::max<int64_t>(65536 / m_dense_samples, 1);
+  int64_t features = std::numeric_limits<int32_t>::max() / feature_extent * feature_extent;
+  layout.dense = true;
+  layout.domain = {0, features - 1, 0, m_dense_samples - 1};
+  layout.tile_extents = {feature_extent, m_dense_samples};
+  return layout;
+}
+
+void MatrixLoader::merge_dense() {
+  auto score = m_schema->slot<float>("SCORE");
+  size_t samples = m_dense_samples;
+  size_t block_features = std::max<size_t>(m_memory_budget / (samples * sizeof(float)), 1);
+  std::vector<float> block;
+  size_t block_start = 0;  // index of the first feature of the block
+  std::map<gtf_encoding_t, size_t> indices;
+
+  auto write_block = [&]() {
+    size_t end = m_dense_features.size();
+    if (end == block_start) return;
+    std::vector<void*> buffers = {block.data()};
+    std::vector<size_t> buffer_sizes = {block.size() * sizeof(float)};
+    m_array_storage->store_subarray(buffers, buffer_sizes,
+                                    {(int64_t)block_start, (int64_t)end - 1, 0,
+                                     (int64_t)samples - 1});
+    block_start = end;
+    block.clear();
+  };
+
+  while (!lanes_empty()) {
+    size_t idx = top_lane();
+    auto& batch = m_lanes[idx].batch;
+    size_t row = m_lanes[idx].next;
+    auto coords = batch.coords[row];  // feature id and sample row
+    gtf_encoding_t feature = {coords[0], batch.levels[row]};
+
+    auto [index, added] = indices.emplace(feature, m_dense_features.size());
+    if (added) {
+      // versions of an id are merged in between each other, so blocks only end at a new id
+      if (m_dense_features.size() - block_start >= block_features &&
+          m_dense_features.back().first != feature.first) {
+        write_block();
+      }
+      m_dense_features.push_back(feature);
+      block.resize((m_dense_features.size() - block_start) * samples,
+                   std::numeric_limits<float>::quiet_NaN());
+    } else if (index->second < block_start) {
+      logger.fatal(OmicsDSException(logger.format(
+          "Cannot import feature {} into dense array {}, its block was already written. The "
+          "features of the files are not in order, they can be sorted with --sort-input",
+          decode_gtf_id(feature), m_array)));
+    }
+    memcpy(&block[(index->second - block_start) * samples + coords[1]],
+           batch.field(score.idx, row), sizeof(float));
+
+    for (auto i = 0u; i < coords.size(); i++) {
+      m_min_coords[i] = std::min(m_min_coords[i], coords[i]);
+      m_max_coords[i] = std::max(m_max_coords[i], coords[i]);
+    }
+    advance_lane();
+  }
+  write_block();
+  m_prefetcher.reset();
+  logger.info("Stored {} features of {} samples densely", m_dense_features.size(), samples);
+}
+
 extents_t MatrixLoader::get_extent(Dimension dimension) {
   return m_array_metadata->get_extent(dimension);
 }
@@ -1192,5 +3160,8 @@ std::shared_ptr<OmicsLoader> get_loader(std::string_view workspace, std::string_
           *import_config.mapping_file, "", !import_config.sample_major);
       break;
   }
+  if (loader) {
+    loader->configure(import_config);
+  }
   return loader;
 }
@@ -29,31 +29,40 @@
 
 #include <fstream>
 
+#include "omicsds_arena.h"
 #include "omicsds_array_metadata.h"
+#include "omicsds_compression.h"
+#include "omicsds_encoder.h"
 #include "omicsds_exception.h"
 #include "omicsds_import_config.h"
+#include "omicsds_loser_tree.h"
 #include "omicsds_module.h"
 #include "omicsds_samplemap.h"
 #include "omicsds_schema.h"
+#include "omicsds_tokenizer.h"
 
 #include <htslib/sam.h>
 #include <algorithm>
 #include <array>
 #include <cassert>
 #include <cmath>
+#include <condition_variable>
 #include <deque>
+#include <exception>
 #include <fstream>
 #include <functional>
 #include <iostream>
 #include <limits>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <numeric>
 #include <queue>
 #include <regex>
 #include <set>
 #include <sstream>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -121,61 +130,46 @@ struct GeneIdMap {
 };
 
 // contains cell information before it is written to disk
+// cells are small headers that are cheap to copy, the fields live in an OmicsArena that outlives
+// the cell and is recycled in bulk once the loader has buffered the cells
 struct OmicsCell {
+  // location of the data of one field in the arena
+  struct Field {
+    const uint8_t* data;
+    uint32_t length;
+  };
+
   std::array<int64_t, 2> coords;  // sample index, position--does not change with schema order
-  std::vector<OmicsFieldData>
-      fields;  // must be in schema order (lexicographically sorted by attribute name)
-  std::shared_ptr<OmicsSchema> schema;
   int file_idx =
       -1;  // index of file in OmicsLoader::m_files, -1 encodes that OmicsLoader should not try to
            // obtain more cells from any file after processing this (probably end cell)
+  uint32_t num_fields = 0;
+  Field* fields = nullptr;  // num_fields entries, in schema order (lexicographically sorted by
+                            // attribute name)
+  uint32_t block = 0;       // arena block of the fields, see OmicsArena::release
 
   OmicsCell() {}
-  OmicsCell(std::array<int64_t, 2> coords, std::shared_ptr<OmicsSchema> schema, int file_idx)
-      : coords(coords),
-        schema(schema),
-        file_idx(file_idx),
-        fields(std::vector<OmicsFieldData>(schema->attributes.size())) {}
-  OmicsCell(OmicsCell&& o)
-      : coords(o.coords), schema(o.schema), fields(std::move(o.fields)), file_idx(o.file_idx) {}
-  OmicsCell(const OmicsCell& o)
-      : coords(o.coords), schema(o.schema), fields(o.fields), file_idx(o.file_idx) {}
-  OmicsCell& operator=(const OmicsCell& o) {
-    coords = o.coords;
-    schema = o.schema;
-    fields = o.fields;
-    file_idx = o.file_idx;
-    return *this;
+  // allocates empty fields for num_fields attributes from arena
+  OmicsCell(std::array<int64_t, 2> coords, uint32_t num_fields, int file_idx, OmicsArena& arena)
+      : coords(coords), file_idx(file_idx), num_fields(num_fields) {
+    fields = reinterpret_cast<Field*>(arena.allocate(num_fields * sizeof(Field), &block));
+    for (auto i = 0u; i < num_fields; i++) {
+      fields[i] = {nullptr, 0};
+    }
   }
-  // helper function to place field in correct position, if in schema
-  // return value indicates successfully added
-  template <class T>
-  bool add_field(std::string name, T elem) {
-    if (!schema) return false;
 
-    auto it = schema->attributes.find(name);
-    if (it == schema->attributes.end()) return false;
-
-    size_t idx = std::distance(schema->attributes.begin(), it);
-    fields[idx].push_back(elem);
-    return true;
+  // copies length bytes at ptr into arena as the data of field idx
+  void set_field(size_t idx, const void* ptr, size_t length, OmicsArena& arena) {
+    fields[idx] = {arena.append(ptr, length), (uint32_t)length};
   }
-
-  // helper function to place field in correct position, if in schema
-  // return value indicates successfully added
   template <class T>
-  bool add_field_ptr(std::string name, T* elem_ptr, int n) {
-    if (!schema) return false;
-
-    auto it = schema->attributes.find(name);
-    if (it == schema->attributes.end()) return false;
-
-    size_t idx = std::distance(schema->attributes.begin(), it);
-    fields[idx].push_pointer_back(elem_ptr, n);
-    return true;
+  void set_field(size_t idx, const T& elem, OmicsArena& arena) {
+    set_field(idx, &elem, sizeof(T), arena);
   }
 
-  bool validate() { return fields.size() == schema->attributes.size(); }
+  // copy of the cell whose fields are in a single allocation from arena, so that they can be
+  // released with arena.release(block)
+  OmicsCell copy(OmicsArena& arena) const;
 
   static OmicsCell create_invalid_cell();  // possibly deprecated because
                                            // OmicsFileReader::get_next_cells now returns a
@@ -183,15 +177,14 @@ struct OmicsCell {
 
   static bool is_invalid_cell(const OmicsCell& cell);
 
-  std::string to_string() {
+  std::string to_string(const OmicsSchema& schema) const {
     std::stringstream ss;
     ss << "beginning of cell {" << coords[0] << ", " << coords[1] << "}" << std::endl;
-    auto fiter = fields.begin();
-    auto aiter = schema->attributes.begin();
-    for (; fiter != fields.end() && aiter != schema->attributes.end(); fiter++, aiter++) {
+    auto aiter = schema.attributes.begin();
+    for (auto i = 0u; i < num_fields && aiter != schema.attributes.end(); i++, aiter++) {
       ss << "\t\t" << aiter->first << std::endl << "\t\t\t\t";
-      for (auto& e : fiter->data) {
-        ss << (int)e << "=" << (char)e << " ";
+      for (auto j = 0u; j < fields[i].length; j++) {
+        ss << (int)fields[i].data[j] << "=" << (char)fields[i].data[j] << " ";
       }
       ss << std::endl;
     }
@@ -215,17 +208,115 @@ std::string container_to_string(const T& c) {
   return ss.str();
 }
 
+// columnar batch of cells filled by OmicsFileReader::get_next_batch
+// attribute columns are in schema order and laid out like the OmicsLoader write buffers: fixed
+// length attributes are packed in data, variable length attributes keep the offset of every cell
+// into var_data in offsets. Batches are meant to be reused, clear() keeps the allocated capacity
+struct CellBatch {
+  std::shared_ptr<OmicsSchema> schema;
+  size_t max_cells = 1024;  // readers stop adding cells once the batch holds this many
+
+  // standard order (SAMPLE, POSITION) as filled by readers, OmicsLoader transforms to schema order
+  std::vector<std::array<int64_t, 2>> coords;
+  // position of the end cell for intervals, -1 if the cell has no end cell
+  std::vector<int64_t> end_positions;
+  // level (third coordinate) of every cell, -1 lets the loader number cells at the same coordinates
+  std::vector<int> levels;
+  std::vector<std::vector<uint8_t>> data;      // empty for variable length attributes
+  std::vector<std::vector<size_t>> offsets;    // empty for fixed length attributes
+  std::vector<std::vector<uint8_t>> var_data;  // empty for fixed length attributes
+  // end cells (file_idx -1) returned by readers that only implement get_next_cells, their fields
+  // are copied to arena which is recycled by clear()
+  std::vector<OmicsCell> end_cells;
+  OmicsArena arena = OmicsArena(64 * 1024);
+
+  CellBatch() {}
+  CellBatch(std::shared_ptr<OmicsSchema> schema, size_t max_cells) { reset(schema, max_cells); }
+  void reset(std::shared_ptr<OmicsSchema> schema, size_t max_cells);
+  void clear();
+
+  size_t size() const { return coords.size(); }
+  bool empty() const { return coords.empty() && end_cells.empty(); }
+  bool full() const { return coords.size() >= max_cells; }
+
+  // starts a new cell, its attributes are then added with append
+  // variable length attributes that are never appended to are left empty for the cell
+  void add_cell(const std::array<int64_t, 2>& cell_coords, int64_t end_position = -1,
+                int level = -1);
+  // appends bytes to attribute idx (see OmicsSchema::index_of_attribute) of the last cell added,
+  // negative indices are ignored so readers can skip attributes missing from the schema
+  void append(int idx, const void* ptr, size_t bytes) {
+    if (idx >= 0 && bytes) memcpy(extend(idx, bytes), ptr, bytes);
+  }
+  template <class T>
+  void append_value(int idx, const T& elem) {
+    append(idx, &elem, sizeof(T));
+  }
+  // grows attribute idx of the last cell by bytes and returns where to write them
+  uint8_t* extend(int idx, size_t bytes) {
+    auto& buffer = m_element_sizes[idx] ? data[idx] : var_data[idx];
+    buffer.resize(buffer.size() + bytes);
+    return buffer.data() + buffer.size() - bytes;
+  }
+  // typed versions of the above for n elements of the attribute of slot, see OmicsSchema::slot
+  template <class T>
+  void append(FieldSlot<T> slot, const typename FieldSlot<T>::value_type* ptr, size_t n) {
+    append(slot.idx, ptr, n * sizeof(T));
+  }
+  template <class T>
+  void append_value(FieldSlot<T> slot, const typename FieldSlot<T>::value_type& elem) {
+    append(slot.idx, &elem, sizeof(T));
+  }
+  template <class T>
+  T* extend(FieldSlot<T> slot, size_t n) {
+    return reinterpret_cast<T*>(extend(slot.idx, n * sizeof(T)));
+  }
+  // appends a copy of cell, which must have fields in schema order
+  void append_cell(const OmicsCell& cell);
+  // appends a copy of the cell at row of other, or of all its cells, including end positions and
+  // levels. other must have the same schema, its end cells are not copied
+  void append_row(const CellBatch& other, size_t row);
+  void append_batch(const CellBatch& other);
+
+  // bytes held by the cells of the batch
+  size_t bytes() const;
+  // appends the cells of the batch to out, deserialize replaces the cells of the batch with those
+  // of a serialized batch of the same schema and returns the bytes consumed
+  void serialize(std::string& out) const;
+  size_t deserialize(const uint8_t* in);
+
+  // size in bytes and location of attribute idx for the cell at row
+  size_t length(size_t idx, size_t row) const {
+    if (m_element_sizes[idx]) return m_element_sizes[idx];
+    return (row + 1 < size() ? offsets[idx][row + 1] : var_data[idx].size()) - offsets[idx][row];
+  }
+  const uint8_t* field(size_t idx, size_t row) const {
+    if (m_element_sizes[idx]) return data[idx].data() + row * m_element_sizes[idx];
+    return var_data[idx].data() + offsets[idx][row];
+  }
+  bool is_variable(size_t idx) const { return !m_element_sizes[idx]; }
+
+  // copy of the cell at row with fields allocated from arena, coords as stored in the batch
+  OmicsCell cell(size_t row, int file_idx, OmicsArena& arena) const;
+  // checks that every fixed length attribute was appended exactly once per cell
+  bool validate() const;
+
+ private:
+  std::vector<size_t> m_element_sizes;  // bytes per cell for fixed length attributes, else 0
+};
+
 // class used to ingest information from files
 // to support new file formats:
 // * derive from OmicsFileReader
 // * customize contructor if relevant (e.g. to process file header)
-// * override get_next_cells
+// * override get_next_batch, or get_next_cells if filling columns is cumbersome
 class OmicsFileReader {  // FIXME encode whether cells are end cells (can be deduced by checking
                          // position against flattened end, but cumbersome)
  public:
   OmicsFileReader(std::string filename, std::shared_ptr<OmicsSchema> schema,
-                  std::shared_ptr<SampleMap> sample_map, int file_idx)
-      : /*m_file(filename),*/ m_reader_util(std::make_shared<FileUtility>(filename)),
+                  std::shared_ptr<SampleMap> sample_map, int file_idx,
+                  size_t buffer_size = FileUtility::default_buffer_size)
+      : /*m_file(filename),*/ m_reader_util(std::make_shared<FileUtility>(filename, buffer_size)),
         m_schema(schema),
         m_sample_map(sample_map),
         m_file_idx(file_idx) {}
@@ -234,6 +325,8 @@ class OmicsFileReader {  // FIXME encode whether cells are end cells (can be ded
   const std::string& get_filename() { return m_reader_util->filename; }
 
   // returns cells for use in OmicsLoader::import
+  // the fields of the cells only need to stay valid until the next call, readers can recycle them
+  // e.g. by allocating them from an arena that is reset with every call
   // empty return vector or vector with invalid first element indicate end of file
   // standard order for coords in returned cells is SAMPLE, POSITION regardless of order, will be
   // transformed by loader subsequent calls must return cells that are either at the same
@@ -241,35 +334,103 @@ class OmicsFileReader {  // FIXME encode whether cells are end cells (can be ded
   // OmicsLoader::less_than previous cells
   virtual std::vector<OmicsCell> get_next_cells() = 0;
 
+  // clears batch and fills it with up to batch.max_cells cells, returns false at end of file
+  // same ordering requirements as get_next_cells, with end cells given by batch.end_positions
+  // the default implementation is an adapter over get_next_cells
+  virtual bool get_next_batch(CellBatch& batch);
+
+  // smallest and largest sample row the file can have cells for, used to skip files that do not
+  // belong to a shard of a sample major import and to stream files covering disjoint samples one
+  // after the other
+  virtual std::array<int64_t, 2> sample_rows() const {
+    return {0, std::numeric_limits<int64_t>::max()};
+  }
+
+  // true while the file has not been opened, OmicsLoader then leaves it closed until the merge
+  // reaches the first cell the file can have according to sample_rows
+  virtual bool deferred() const { return false; }
+  // smallest coordinates in schema order the file can have cells at
+  std::array<int64_t, 2> first_coords() const;
+
  protected:
+  // for readers that wrap source, shares its file, schema and sample map
+  OmicsFileReader(const OmicsFileReader& source)
+      : m_schema(source.m_schema),
+        m_sample_map(source.m_sample_map),
+        m_file_idx(source.m_file_idx),
+        m_reader_util(source.m_reader_util) {}
+
   std::shared_ptr<OmicsSchema> m_schema;
   std::shared_ptr<SampleMap> m_sample_map;
   int m_file_idx;
   std::shared_ptr<FileUtility> m_reader_util;
+
+  // implements get_next_cells for readers that natively fill batches
+  std::vector<OmicsCell> get_next_cells_from_batch();
+  std::unique_ptr<CellBatch> m_cell_batch;
+  OmicsArena m_arena = OmicsArena(64 * 1024);  // fields of the cells from get_next_cells
 };
 
-// uses htslib to read SAM files (must have .sam extension)
+// uses htslib to read SAM, BAM or CRAM files (must have .sam, .bam or .cram extension)
+// BGZF blocks of BAM and CRAM containers are decompressed by decompression_threads threads of
+// htslib, 0 decompresses on the thread calling get_next_batch. CRAM references are looked up by
+// htslib, through the header or REF_PATH
+// reads of indexed BAM and CRAM files are only read for the contigs of the genomic map that overlap
+// position_range, the flattened positions of a position major shard, through the BAI/CSI index.
+// Every contig is read from its start, the index only finds reads by their alignment and the end
+// cells of templates that start before the range would be lost otherwise. Shards of different
+// contigs thereby read disjoint parts of the file in parallel. Files without an index are read
+// sequentially
 // uses file name (without path) as sample name
+// unmapped reads have no position and are skipped
 // TODO (for both SamReader and SamExporter)
-// * support BAM format (should only require minimal additions if htslib has good support)
 // * potentially transform POS to 0 based and back for query (1 based in SAM)
 // * look into RNEXT field, htslib seems to transform =,* into 0,-1, but might also need to write
 // something to header when exporting
 // * figure out why htslib is making PNEXT 1 based
-// * figure out what htslib is doing to QUAL (goes from ascii to some kind of binary format with
-// mixed ascii (?). Unsure)
 class SamReader : public OmicsFileReader {
  public:
   SamReader(std::string filename, std::shared_ptr<OmicsSchema> schema,
-            std::shared_ptr<SampleMap> sample_map, int file_idx);
+            std::shared_ptr<SampleMap> sample_map, int file_idx, int decompression_threads = 0,
+            std::array<int64_t, 2> position_range = {std::numeric_limits<int64_t>::min(),
+                                                     std::numeric_limits<int64_t>::max()});
   ~SamReader();
-  std::vector<OmicsCell> get_next_cells() override;
+  std::vector<OmicsCell> get_next_cells() override { return get_next_cells_from_batch(); }
+  bool get_next_batch(CellBatch& batch) override;
+  std::array<int64_t, 2> sample_rows() const override {
+    return {(int64_t)m_row_idx, (int64_t)m_row_idx};
+  }
 
  protected:
   uint64_t m_row_idx;  // row corresponding to sample
   samFile* m_fp;       // file pointer
   bam_hdr_t* m_hdr;    // header
   bam1_t* m_align;     // alignment
+  hts_idx_t* m_idx = nullptr;
+  hts_itr_t* m_itr = nullptr;  // over m_regions[m_region]
+  struct Region {
+    int tid;
+    int64_t begin, end;  // zero based, end is exclusive
+  };
+  std::vector<Region> m_regions;
+  size_t m_region = 0;
+  // reads the next alignment into m_align, from the regions of the index if there is one
+  bool read_next();
+  // flattened start, flattened last position and name length of the contigs of the header by tid,
+  // resolved once per contig instead of once per read
+  struct Contig {
+    int64_t start = -1;
+    int64_t end = -1;
+    size_t name_length = 0;
+  };
+  std::vector<Contig> m_contigs;
+  const Contig& contig(int tid);
+  FieldSlot<char> m_qname, m_rname, m_seq, m_qual;
+  FieldSlot<uint16_t> m_flag;
+  FieldSlot<int32_t> m_pos, m_rnext, m_pnext, m_tlen;
+  FieldSlot<uint8_t> m_mapq;
+  FieldSlot<uint32_t> m_cigar;
+  FieldSlot<int64_t> m_span;
 };
 
 // reads ucsc bed files (must have .bed extension)
@@ -277,12 +438,22 @@ class SamReader : public OmicsFileReader {
 class BedReader : public OmicsFileReader {
  public:
   BedReader(std::string filename, std::shared_ptr<OmicsSchema> schema,
-            std::shared_ptr<SampleMap> sample_map, int file_idx);
-  std::vector<OmicsCell> get_next_cells() override;
+            std::shared_ptr<SampleMap> sample_map, int file_idx,
+            size_t buffer_size = FileUtility::default_buffer_size);
+  std::vector<OmicsCell> get_next_cells() override { return get_next_cells_from_batch(); }
+  bool get_next_batch(CellBatch& batch) override;
+  std::array<int64_t, 2> sample_rows() const override {
+    return {(int64_t)m_row_idx, (int64_t)m_row_idx};
+  }
 
  protected:
   std::string m_sample_name;
   uint64_t m_row_idx;  // row corresponding to sample
+  OmicsLineReader m_lines;
+  FieldSlot<char> m_chrom, m_gene, m_sample, m_name;
+  FieldSlot<uint64_t> m_start, m_end;
+  FieldSlot<float> m_score;
+  FieldSlot<int64_t> m_span;
 };
 
 /**
@@ -294,13 +465,17 @@ class BedReader : public OmicsFileReader {
  * GENE          [gene name]   [gene name]
  * [sample name] [score]       [score]
  *
- * Currently matrix file can be either sample or id major, but must match schema order
+ * Matrix file can be either sample or id major, but must match schema order unless its cells are
+ * sorted by a SortingReader
  */
 class MatrixReader : public OmicsFileReader {
  public:
   MatrixReader(std::string filename, std::shared_ptr<OmicsSchema> schema,
-               std::shared_ptr<SampleMap> sample_map, int file_idx);
-  std::vector<OmicsCell> get_next_cells() override;
+               std::shared_ptr<SampleMap> sample_map, int file_idx, bool match_schema_order = true,
+               size_t buffer_size = FileUtility::default_buffer_size);
+  std::vector<OmicsCell> get_next_cells() override { return get_next_cells_from_batch(); }
+  // the gtf id version is used as the level of the cell
+  bool get_next_batch(CellBatch& batch) override;
 
  protected:
   std::vector<std::string>
@@ -309,8 +484,318 @@ class MatrixReader : public OmicsFileReader {
   std::vector<float> m_row_scores;  // buffer of scores in current row
   size_t m_column_idx = 0;          // current column position in matrix
   const std::string m_token_separator = "\t,";
-  std::string m_current_token;  // can be sample or gene depending on m_id_major
-  bool parse_next(std::string& sample, std::string& gene, float& score);
+  // rows of the samples (id major) or encoded ids of the genes (sample major) in the header, and of
+  // the sample or gene of the current row, so that they are looked up once instead of for every
+  // cell. Samples missing from the sample map have row -1, genes that cannot be encoded id 0
+  std::vector<int64_t> m_column_rows;
+  std::vector<gtf_encoding_t> m_column_ids;
+  int64_t m_current_row = -1;
+  gtf_encoding_t m_current_id = {0, 0};
+  int64_t sample_row(const std::string& sample);
+  gtf_encoding_t gene_id(const std::string& gene);
+  // lines are tokenized in the buffer of m_lines, without copying the line or its tokens
+  OmicsLineReader m_lines;
+  // reads the scores of the next line into m_row_scores, false at end of file
+  bool parse_line();
+  FieldSlot<float> m_score;
+};
+
+// sorts the cells of another reader in schema order, for files that are not sorted
+// the cells are read into runs of at most run_bytes, which are sorted and spilled to files named
+// run_prefix followed by the run number, and merged back when batches are requested. A file that
+// fits in a single run of at most resident_bytes is kept in memory instead. Only the rows in range
+// of the first dimension in schema order, or whose end cell is in range, are kept
+class SortingReader : public OmicsFileReader {
+ public:
+  SortingReader(std::shared_ptr<OmicsFileReader> reader, const std::string& run_prefix,
+                size_t run_bytes, size_t resident_bytes, size_t block_size,
+                std::array<int64_t, 2> range = {std::numeric_limits<int64_t>::min(),
+                                                 std::numeric_limits<int64_t>::max()});
+  ~SortingReader();
+  std::vector<OmicsCell> get_next_cells() override { return get_next_cells_from_batch(); }
+  bool get_next_batch(CellBatch& batch) override;
+  std::array<int64_t, 2> sample_rows() const override { return m_reader->sample_rows(); }
+  bool deferred() const override { return m_reader->deferred() && !m_runs_created; }
+
+  // number of runs the file was split into, 0 before the first batch
+  size_t num_runs() const { return m_runs.size(); }
+
+ protected:
+  std::shared_ptr<OmicsFileReader> m_reader;
+  std::string m_run_prefix;
+  size_t m_run_bytes;
+  size_t m_resident_bytes;
+  size_t m_block_size;  // cells per block of a spilled run, runs are read back a block at a time
+  std::array<int64_t, 2> m_range;
+
+  struct SortedRun {
+    std::string filename;
+    std::shared_ptr<FileUtility> file;  // nullptr once exhausted, or for a run kept in memory
+    CellBatch block;
+    size_t next = 0;  // next row of block to be merged
+  };
+  std::vector<SortedRun> m_runs;
+  bool m_runs_created = false;
+  OmicsLoserTree m_merge;
+  std::vector<uint8_t> m_block_buffer;
+
+  bool in_range(const CellBatch& batch, size_t row) const;
+  // reads m_reader to the end into sorted runs
+  void create_runs();
+  // rows of run in schema order
+  std::vector<size_t> sorted_rows(const CellBatch& run) const;
+  void spill(const CellBatch& run);
+  // replaces the block of run with its next block, false once the run is exhausted
+  bool load_block(SortedRun& run);
+};
+
+// end cells waiting in the merge of OmicsLoader for the merge to reach their coordinates, which
+// can be far from the starts of their intervals or reads. The heap only holds the coordinates of
+// every end cell and the row of its fields in a batch of pending cells. Once the pending cells take
+// more than max_bytes they are compacted to the cells still queued, or spilled as a sorted run to a
+// file named run_prefix followed by the run number if those take more than half of max_bytes. Runs
+// are read back a block of block_size cells at a time, so memory stays flat however many end cells
+// are queued. Coordinates are in schema order
+class OmicsEndCellQueue {
+ public:
+  OmicsEndCellQueue() {}
+  OmicsEndCellQueue(const OmicsEndCellQueue&) = delete;
+  OmicsEndCellQueue& operator=(const OmicsEndCellQueue&) = delete;
+  ~OmicsEndCellQueue();
+  void reset(std::shared_ptr<OmicsSchema> schema, const std::string& run_prefix, size_t max_bytes,
+             size_t block_size);
+
+  bool empty() const { return m_heap.empty() && m_run_heap.empty(); }
+  const std::array<int64_t, 2>& top_coords() const {
+    return top_in_run() ? top_run_coords() : m_heap.front().coords;
+  }
+  // the end cell with the smallest coordinates, its fields are valid until the next call to top
+  OmicsCell top();
+  void pop();
+  // queues a copy of the cell at row of batch as an end cell at coords
+  void push(const CellBatch& batch, size_t row, const std::array<int64_t, 2>& coords);
+  // queues a copy of cell, whose coords must be in schema order
+  void push(const OmicsCell& cell);
+  // queues an end cell at coords that only refers back to its start through the flattened start
+  // and end positions in the SPAN attribute of span_slot, its other attributes are left empty or
+  // zeroed, see OmicsExporter::query
+  void push_marker(const std::array<int64_t, 2>& coords, FieldSlot<int64_t> span_slot,
+                   const std::array<int64_t, 2>& span);
+
+  // runs spilled so far
+  size_t num_runs() const { return m_num_runs; }
+
+ protected:
+  std::shared_ptr<OmicsSchema> m_schema;
+  std::string m_run_prefix;
+  size_t m_max_bytes = 0;
+  size_t m_block_size = 1024;
+
+  struct Marker {
+    std::array<int64_t, 2> coords;
+    size_t row;  // of m_pending
+  };
+  struct MarkerGreater {
+    bool operator()(const Marker& l, const Marker& r) const { return r.coords < l.coords; }
+  };
+  std::vector<Marker> m_heap;
+  CellBatch m_pending;
+  OmicsArena m_top_arena = OmicsArena(64 * 1024);
+
+  struct Run {
+    std::string filename;
+    std::shared_ptr<FileUtility> file;  // nullptr once exhausted
+    CellBatch block;
+    size_t next = 0;
+  };
+  std::vector<Run> m_runs;
+  std::vector<size_t> m_run_heap;  // runs that are not exhausted, by the coords of their next cell
+  size_t m_num_runs = 0;
+  std::vector<uint8_t> m_block_buffer;
+
+  bool run_greater(size_t l, size_t r) const {
+    return m_runs[r].block.coords[m_runs[r].next] < m_runs[l].block.coords[m_runs[l].next];
+  }
+  bool top_in_run() const {
+    return !m_run_heap.empty() && (m_heap.empty() || !(m_heap.front().coords < top_run_coords()));
+  }
+  const std::array<int64_t, 2>& top_run_coords() const {
+    auto& run = m_runs[m_run_heap.front()];
+    return run.block.coords[run.next];
+  }
+  void queued();  // called after every push, makes room once the pending cells take max_bytes
+  void spill();
+  void compact();
+};
+
+// counts the input files of an import that are open at a time, see PooledReader. Files are only
+// opened once the merge reaches them, so files that do not overlap, e.g. the files of different
+// samples in a sample major import, are not open together. Files that overlap have to be, a
+// warning is logged once more than max_open are
+class OmicsReaderPool {
+ public:
+  OmicsReaderPool(size_t max_open) : m_max_open(std::max<size_t>(max_open, 1)) {}
+  void open();
+  void close();
+  size_t max_open() const { return m_max_open; }
+  // largest number of files open at once so far
+  size_t peak_open() const;
+
+ private:
+  size_t m_max_open;
+  size_t m_open = 0;
+  size_t m_peak = 0;
+  bool m_warned = false;
+  mutable std::mutex m_mutex;
+};
+
+// opens the file of the reader constructed by open once its cells are first needed and closes it
+// at end of file, so that imports of thousands of files only hold the buffers and handles of the
+// files being merged. For sample major imports the sample rows are probed up front with a reader
+// holding a small buffer, which is closed right away
+class PooledReader : public OmicsFileReader {
+ public:
+  typedef std::function<std::shared_ptr<OmicsFileReader>(size_t buffer_size)> open_t;
+
+  PooledReader(std::string filename, std::shared_ptr<OmicsSchema> schema,
+               std::shared_ptr<SampleMap> sample_map, int file_idx, open_t open,
+               std::shared_ptr<OmicsReaderPool> pool, size_t buffer_size, bool probe_sample_rows);
+  ~PooledReader();
+  std::vector<OmicsCell> get_next_cells() override { return get_next_cells_from_batch(); }
+  bool get_next_batch(CellBatch& batch) override;
+  std::array<int64_t, 2> sample_rows() const override { return m_sample_rows; }
+  bool deferred() const override { return !m_reader && !m_closed; }
+
+  bool is_open() const { return (bool)m_reader; }
+
+ protected:
+  open_t m_open;
+  std::shared_ptr<OmicsReaderPool> m_pool;
+  size_t m_buffer_size;
+  std::shared_ptr<OmicsFileReader> m_reader;
+  bool m_closed = false;  // end of file was reached
+  std::array<int64_t, 2> m_sample_rows = {0, std::numeric_limits<int64_t>::max()};
+};
+
+// merges the cells of a group of readers in schema order, so that OmicsLoader merges a few groups
+// instead of every file of very wide file lists. Groups of merging readers give more levels. The
+// inputs are streamed a batch of batch_size cells at a time, their end cells are handed out with
+// the next batch. Deferred inputs are only opened once the merge reaches them, like in OmicsLoader
+class MergingReader : public OmicsFileReader {
+ public:
+  MergingReader(const std::vector<std::shared_ptr<OmicsFileReader>>& readers, size_t batch_size,
+                int file_idx);
+  std::vector<OmicsCell> get_next_cells() override { return get_next_cells_from_batch(); }
+  bool get_next_batch(CellBatch& batch) override;
+  std::array<int64_t, 2> sample_rows() const override { return m_sample_rows; }
+  bool deferred() const override { return m_deferred && !m_started; }
+
+ protected:
+  struct Input {
+    std::shared_ptr<OmicsFileReader> reader;
+    CellBatch batch;
+    size_t next = 0;  // next row of batch to be merged
+    bool deferred = false;
+  };
+  std::vector<Input> m_inputs;
+  size_t m_batch_size;
+  OmicsLoserTree m_merge;
+  bool m_started = false;
+  bool m_deferred = true;  // all inputs are deferred
+  std::array<int64_t, 2> m_sample_rows = {std::numeric_limits<int64_t>::max(), 0};
+  // end cells of the input batches, copied to the next batch
+  std::vector<OmicsCell> m_end_cells;
+  OmicsArena m_end_cell_arena = OmicsArena(64 * 1024);
+
+  void start();
+  // replaces the batch of input idx with its next batch, false at end of file
+  bool load(size_t idx);
+  void open_deferred();
+};
+
+// parses ahead of OmicsLoader::import on a pool of worker threads
+// each reader gets a bounded queue of batches, and a reader is only ever parsed by one worker at a
+// time, so OmicsFileReader implementations do not have to be thread safe. Deferred readers are only
+// parsed once their first batch is requested. Exceptions thrown while parsing are rethrown to the
+// consumer from get_next_batch
+class OmicsReaderPrefetcher {
+ public:
+  OmicsReaderPrefetcher(const std::vector<std::shared_ptr<OmicsFileReader>>& readers,
+                        std::shared_ptr<OmicsSchema> schema, size_t batch_size, size_t num_threads,
+                        size_t queue_depth = 2);
+  ~OmicsReaderPrefetcher();
+  // same contract as OmicsFileReader::get_next_batch, blocks until the reader at idx has parsed its
+  // next batch. The buffers of the batch passed in are recycled for parsing
+  bool get_next_batch(int idx, CellBatch& batch);
+  // starts parsing a deferred reader ahead of its first get_next_batch
+  void prefetch(int idx);
+
+ private:
+  struct ReaderQueue {
+    std::deque<CellBatch> batches;
+    std::vector<CellBatch> spare;  // consumed batches whose buffers can be reused
+    bool end_of_file = false;
+    bool scheduled = false;  // reader is waiting in m_ready or being parsed by a worker
+    std::exception_ptr error;
+  };
+
+  void work();
+  void schedule(size_t idx);  // expects m_mutex to be held
+
+  const std::vector<std::shared_ptr<OmicsFileReader>>& m_readers;
+  std::shared_ptr<OmicsSchema> m_schema;
+  size_t m_batch_size;
+  size_t m_queue_depth;
+  std::vector<ReaderQueue> m_queues;
+  std::deque<size_t> m_ready;
+  std::mutex m_mutex;
+  std::condition_variable m_work_available;
+  std::condition_variable m_batches_available;
+  bool m_stop = false;
+  std::vector<std::thread> m_workers;
+};
+
+// stores the write buffers of OmicsLoader on a background thread, so that the merge can fill the
+// next set of buffers while the previous one is being written out. Sets are stored in the order
+// they are submitted. Of num_sets buffer sets one is being filled by the loader, once the others
+// are all in flight acquire blocks until the oldest has been stored. Exceptions thrown while
+// storing are rethrown to the loader from acquire and wait
+class OmicsBufferWriter {
+ public:
+  struct BufferSet {
+    std::vector<std::vector<uint8_t>> buffers;
+    std::vector<std::vector<uint8_t>> var_buffers;
+    std::vector<uint64_t> coords_buffer;
+    // arguments to OmicsDSArrayStorage::store, point into the buffers above
+    std::vector<void*> pointers;
+    std::vector<size_t> sizes;
+  };
+
+  OmicsBufferWriter(std::shared_ptr<OmicsDSArrayStorage> storage, size_t num_sets = 2);
+  // sets that are still queued are stored before the writer thread is joined
+  ~OmicsBufferWriter();
+  // returns a set that is not in flight for the loader to fill, the buffers of a set are empty
+  // the first time it is handed out
+  BufferSet acquire();
+  void submit(BufferSet&& set);
+  // blocks until all submitted sets have been stored
+  void wait();
+
+ private:
+  void work();
+
+  std::shared_ptr<OmicsDSArrayStorage> m_storage;
+  size_t m_max_sets;     // sets outside of the loader, one less than num_sets
+  size_t m_created = 0;  // sets handed out so far
+  std::deque<BufferSet> m_queue;
+  std::vector<BufferSet> m_stored;  // stored sets whose buffers can be reused
+  bool m_storing = false;
+  bool m_stop = false;
+  std::exception_ptr m_error;
+  std::mutex m_mutex;
+  std::condition_variable m_set_submitted;
+  std::condition_variable m_set_stored;
+  std::thread m_thread;
 };
 
 // used to ingest information into OmicsDS
@@ -320,13 +805,8 @@ class MatrixReader : public OmicsFileReader {
 // * customize constructor if required
 // * override create_schema
 // * override add_reader
-// TODO:
-// sharding?
-// when some specified pq size is reached stop reading from files and write everything out to
-// fragment (continued) create new fragment and resume reading from files This also helps with the
-// worst case scenario where the end cells returned from file readers are very far from the starts
-// in this case the pq size would increase linearly with reads, rather than staying mostly constant
-// (when end cells are not retained for a very long time in memory)
+// * override create_shard to support sharded imports
+// end cells that are far from their starts are spilled to the workspace, see OmicsEndCellQueue
 class OmicsLoader : public OmicsDSModule {
  public:
   OmicsLoader(const std::string& workspace, const std::string& array,
@@ -335,14 +815,35 @@ class OmicsLoader : public OmicsDSModule {
               const std::string& mapping_file = "",  // see GenomicMap struct
               bool position_major = true  // sample major (false) or position major (true)
   );
-  virtual ~OmicsLoader() {}
+  virtual ~OmicsLoader();
   virtual void import();             // import data from callsets
   virtual void create_schema() = 0;  //
   void
   initialize();  // cannot be part of constructor because it invokes create_schema, which is virtual
+  // picks up tuning options from the import configuration, must be called before initialize
+  virtual void configure(const OmicsDSImportConfig& config);
+  // layout of the array created by the import, sparse arrays are bounded by the genomic map and
+  // their data tiles sized to the cells of the schema. Planned by initialize once the schema exists
+  virtual OmicsArrayLayout plan_layout();
+
  protected:
+  std::string m_workspace;
+  std::string m_array;
+  std::string m_sample_map_file;
+  std::string m_mapping_file;
+  // adds the files to an existing array as new fragments instead of replacing the workspace
+  bool m_append = false;
   std::shared_ptr<SampleMap> m_sample_map;
   void store_buffers();
+  // divides the memory budget over the write buffer sets and, within a set, over the buffers of
+  // the attributes by their bytes per cell. Variable length attributes are sized by the bytes per
+  // cell observed so far, the first batches of all files stand in before anything was written
+  void size_buffers();
+  // true if the bytes per cell of a variable length attribute observed so far moved past the
+  // slack size_buffers left around the average it planned with
+  bool left_planned_sizes() const;
+  // resizes the current write buffers to the capacities from size_buffers
+  void allocate_buffers();
 
   // data for array database storage
   // stores offset for variable length attributes, and data for constant length ones
@@ -354,9 +855,17 @@ class OmicsLoader : public OmicsDSModule {
   // persists between writes
   std::vector<size_t> m_attribute_offsets;
 
-  // TODO: should be passed in via api or tools or protobuf
-  size_t buffer_size = 10240;
-  bool check_buffer_sizes(const OmicsCell& cell);
+  // total size in bytes of the write buffers over all buffer sets
+  size_t m_memory_budget = 64 * 1024 * 1024;
+  // cells that fit in a set of write buffers, and the capacity in bytes of each buffer
+  size_t m_cells_per_write = 0;
+  std::vector<size_t> m_buffer_capacities;
+  std::vector<size_t> m_var_buffer_capacities;
+  // bytes of variable length attributes and cells in the buffers written so far
+  std::vector<uint64_t> m_observed_var_bytes;
+  uint64_t m_observed_cells = 0;
+  // average bytes per cell of the variable length attributes the buffers were last sized with
+  std::vector<double> m_planned_var_bytes;
   std::vector<size_t> m_buffer_lengths;
   std::vector<size_t> m_var_buffer_lengths;
   size_t m_coords_buffer_length;
@@ -364,6 +873,29 @@ class OmicsLoader : public OmicsDSModule {
   // insert relevant information in buffers
   // and var_buffers (for variable fields)
   void buffer_cell(const OmicsCell& cell, int level = 0);
+  // same as buffer_cell for the cell at row of the batch of lane idx, the attributes are only
+  // copied by flush_run so that consecutive rows of a batch are copied in one go
+  void buffer_row(size_t idx, size_t row, int level);
+  // buffers the rows of the batch of lane idx from its next row on in one go, up to the next cell
+  // of any other lane or end cell, the end of the shard or the first row out of order. The rows
+  // must carry their levels and have no end cells, see m_bulk_rows. Returns the number of rows
+  // buffered, which are accounted for in the extents, and sets last to the coords of the last one
+  size_t buffer_rows(size_t idx, std::array<int64_t, 2>& last);
+  void flush_run();
+  // rows [begin, end) of the batch of lane are accounted for in the buffers but not copied yet
+  struct Run {
+    size_t lane = 0;
+    size_t begin = 0;
+    size_t end = 0;
+    std::vector<size_t> buffer_start;
+    std::vector<size_t> var_buffer_start;
+  } m_run;
+  template <class F>
+  bool check_buffer_sizes(F field_length);
+  // writes the buffers out if a cell with attributes of field_length bytes does not fit, buffers
+  // of variable length attributes grow when the cell does not fit in empty buffers either
+  template <class F>
+  void make_room(F field_length);
   void write_buffers();
   size_t m_buffered_cells = 0;
   size_t m_total_processed_cells = 0;
@@ -374,26 +906,171 @@ class OmicsLoader : public OmicsDSModule {
   virtual void add_reader(
       const std::string&
           filename) = 0;  // construct a derived class of OmicsFileReader and insert in m_files
+  // used by add_reader, inserts the reader constructed by open with buffers of m_reader_buffer_size
+  // bytes in m_files. With more files than m_max_open_files the file is only opened once the merge
+  // reaches it, see PooledReader. Sample major shards insert nullptr for files of other samples
+  void add_file(const std::string& filename, PooledReader::open_t open);
   std::string m_file_list;
   std::vector<std::shared_ptr<OmicsFileReader>> m_files;
   typedef std::shared_ptr<OmicsFileReader> omics_fptr;
-  std::priority_queue<OmicsCell, std::vector<OmicsCell>, std::function<bool(OmicsCell, OmicsCell)>>
-      m_pq;
   int m_idx;
-  static bool comparator(OmicsCell _l,
-                         OmicsCell _r) {  // returns which cell is first in schema order
-    auto l = _l.coords;
-    auto r = _r.coords;
-    return (l[0] > r[0]) || (l[0] == r[0] && l[1] > r[1]);
+
+  // k-way merge of the cells from all files, in schema order
+  // every file is a lane holding its current batch, the loser tree is only keyed on the coordinates
+  // of the next row of each lane. End cells can be produced out of order by a file, so they are
+  // kept in m_end_cells ordered by their coordinates instead
+  struct Lane {
+    CellBatch batch;
+    size_t next = 0;        // next row of batch to be merged
+    bool deferred = false;  // the file is not open yet, keyed on the first cell it can have
+  };
+  std::vector<Lane> m_lanes;
+  size_t m_batch_size = 1024;
+  OmicsLoserTree m_merge;
+  // holds a quarter of the memory budget of end cells, further ones are spilled to runs named
+  // m_end_cell_prefix followed by the run number
+  OmicsEndCellQueue m_end_cells;
+  std::string m_end_cell_prefix;
+  // flattened start and end positions of reads and intervals, if in the schema end cells are only
+  // stored as markers that refer back to their starts
+  FieldSlot<int64_t> m_span;
+  // files whose cells do not overlap, e.g. the files of different samples in a sample major
+  // import, are streamed one after the other in m_lane_order instead of being merged, only their
+  // end cells go through the heap
+  bool m_sequential = false;
+  // the files of the list are in order and do not overlap, without this hint sample major imports
+  // detect files that cover disjoint sample rows
+  bool m_presorted_files = false;
+  std::vector<size_t> m_lane_order;
+  size_t m_order_pos = 0;
+  // orders the files for m_sequential if they do not overlap
+  void order_disjoint_files();
+  // moves on to the first lane from m_order_pos on that has cells
+  void next_sequential_lane();
+
+  // lane whose next row is the next row of the merge, and its coordinates, only meaningful if
+  // !lanes_empty()
+  bool lanes_empty() const {
+    return m_sequential ? m_order_pos >= m_lane_order.size() : m_merge.empty();
+  }
+  size_t top_lane() const { return m_sequential ? m_lane_order[m_order_pos] : m_merge.top(); }
+  const std::array<int64_t, 2>& top_lane_key() const {
+    if (!m_sequential) return m_merge.top_key();
+    auto& lane = m_lanes[top_lane()];
+    return lane.batch.coords[lane.next];
   }
+  // drops the top lane once its file is exhausted or of no further interest
+  void exhaust_lane();
+  bool merge_empty() const { return lanes_empty() && m_end_cells.empty(); }
+  // end cells go before rows with the same coordinates
+  bool next_is_end_cell() const {
+    return !m_end_cells.empty() &&
+           (lanes_empty() || !less_than(top_lane_key(), m_end_cells.top_coords()));
+  }
+  // coordinates of the next cell in the merge, merge must not be empty
+  const std::array<int64_t, 2>& peek_coords() const {
+    return next_is_end_cell() ? m_end_cells.top_coords() : top_lane_key();
+  }
+  // moves the top lane to its next row, loading the next batch if required
+  void advance_lane();
+  // replaces the batch of lane idx with the next batch from its file, false at end of file
+  bool load_batch(size_t idx);
+  // opens the files of deferred lanes that win the merge until the winner is not deferred
+  void open_deferred_lanes();
+  void push_from_all_files();
+  // merges all files into the write buffers, writing them out as they fill up
+  void merge_files();
 
-  bool less_than(const std::array<int64_t, 2>& l, const std::array<int64_t, 2>& r) {
+  bool less_than(const std::array<int64_t, 2>& l, const std::array<int64_t, 2>& r) const {
     return (l[0] < r[0]) || (l[0] == r[0] && l[1] < r[1]);
   }
-  bool less_than(const OmicsCell& l, const OmicsCell& r) { return less_than(l.coords, r.coords); }
-  void push_from_idxs(const std::set<int>& idxs);
-  void push_file_from_cell(const OmicsCell& cell);
-  void push_from_all_files();
+  bool less_than(const OmicsCell& l, const OmicsCell& r) const {
+    return less_than(l.coords, r.coords);
+  }
+
+  // cells at the same coordinates are numbered with increasing levels
+  int next_level(const std::array<int64_t, 2>& coords);
+  std::array<int64_t, 2> m_last_coords = {-1, -1};
+  int m_level = 0;
+  // bounding box in schema order of all cells merged so far
+  std::array<int64_t, 2> m_min_coords = {std::numeric_limits<int64_t>::max(),
+                                         std::numeric_limits<int64_t>::max()};
+  std::array<int64_t, 2> m_max_coords = {-1, -1};
+  // input files that are not sorted split the array into multiple fragments instead of failing
+  bool m_split_unsorted_input = false;
+  // the cells of the files carry their levels and have no end cells, as for feature level matrices,
+  // so consecutive rows of a file are merged a batch at a time with buffer_rows. Requires every
+  // attribute to be fixed length, checked by initialize
+  bool m_bulk_rows = false;
+  // sample rows of the reads and intervals of the import, recorded in the array metadata so that
+  // appends only add other samples, see initialize
+  std::vector<uint64_t> m_sample_rows;
+  // every file is read through a SortingReader, its runs are spilled to files starting with
+  // m_sort_prefix in the m_sort_dir of the workspace, which is removed with the loader
+  bool m_sort_input = false;
+  std::string m_sort_dir;
+  std::string m_sort_prefix;
+
+  // files beyond which input files are opened lazily through m_reader_pool, and the buffer size of
+  // every reader, which shrinks with the number of files that can be open at once so that their
+  // buffers fit in the memory budget
+  size_t m_max_open_files = 1024;
+  size_t m_reader_buffer_size = FileUtility::default_buffer_size;
+  std::shared_ptr<OmicsReaderPool> m_reader_pool;
+
+  // files are merged in groups of at most m_merge_fan_in files, see MergingReader, 0 merges all
+  // files at once
+  size_t m_merge_fan_in = 0;
+
+  // number of threads decompressing every compressed input file, for the readers that support it
+  size_t m_decompression_threads = 0;
+
+  // compression of the array created by the import, entries of the import configuration replace
+  // those of default_compression
+  OmicsCompressionMap m_compression;
+  virtual OmicsCompressionMap default_compression();
+  // number of threads parsing input files ahead of the merge, 0 parses on the importing thread
+  size_t m_parse_threads = 0;
+  // declared after m_files so that workers are joined before the readers are destroyed
+  std::unique_ptr<OmicsReaderPrefetcher> m_prefetcher;
+  bool get_next_batch(size_t idx, CellBatch& batch);
+
+  // number of write buffer sets, with more than one the buffers are stored on a background thread
+  // while the merge fills the next set
+  size_t m_write_buffer_sets = 1;
+  std::unique_ptr<OmicsBufferWriter> m_writer;
+  // blocks until the buffers handed to m_writer are stored, the array must not be reopened or
+  // finalized before
+  void wait_for_writes();
+
+  // sharded imports split the first dimension in schema order, positions for position major and
+  // samples for sample major arrays, into m_shards ranges. Every shard is imported by a loader of
+  // its own on a thread of its own into a fragment of its own, and only buffers the cells in its
+  // range, so the fragments do not overlap. Sample major shards skip the files of other samples,
+  // position major ones are only supported if reads_position_shards
+  size_t m_shards = 1;
+  bool m_is_shard = false;
+  std::array<int64_t, 2> m_shard_range = {std::numeric_limits<int64_t>::min(),
+                                          std::numeric_limits<int64_t>::max()};
+  bool in_shard(const std::array<int64_t, 2>& coords) const {
+    return coords[0] >= m_shard_range[0] && coords[0] < m_shard_range[1];
+  }
+  // n + 1 increasing boundaries of n shards, fewer if the domain cannot be split n ways and empty
+  // if it is not known. Positions are split at the contigs of the genomic map, samples evenly
+  virtual std::vector<int64_t> shard_boundaries(size_t n);
+  // true if the readers of position major shards only read the cells in their range. Otherwise
+  // every shard would parse every file from its start, and sharding is refused by configure
+  virtual bool reads_position_shards() { return false; }
+  // sample rows of a file resolved from its name without opening it, {0, max} if they are only
+  // known once the file is read. Sample major shards only construct the readers of their samples
+  virtual std::array<int64_t, 2> sample_rows_from_name(const std::string& filename) {
+    return {0, std::numeric_limits<int64_t>::max()};
+  }
+  // constructs a loader of the same kind over the same files, nullptr if sharding is not supported
+  virtual std::shared_ptr<OmicsLoader> create_shard() { return nullptr; }
+  std::vector<std::shared_ptr<OmicsLoader>> m_shard_loaders;
+  // imports the shards on their own threads, false if the import is not sharded
+  bool import_shards();
 };
 
 // used to ingest SAM files
@@ -407,6 +1084,13 @@ class ReadCountLoader : public OmicsLoader {
 
  protected:
   virtual void add_reader(const std::string& filename) override;
+  std::shared_ptr<OmicsLoader> create_shard() override;
+  // if every file is an indexed BAM or CRAM file, see SamReader
+  bool reads_position_shards() override;
+  // the row of the file name in the sample map, see SamReader
+  std::array<int64_t, 2> sample_rows_from_name(const std::string& filename) override;
+  // the names, cigars, sequences and qualities of reads compress better with zstd
+  OmicsCompressionMap default_compression() override;
 };
 
 // used to ingest Bed and Matrix files
@@ -424,6 +1108,7 @@ class TranscriptomicsLoader : public OmicsLoader {
 
  protected:
   virtual void add_reader(const std::string& filename) override;
+  std::shared_ptr<OmicsLoader> create_shard() override;
   //    std::shared_ptr<GeneIdMap> m_gene_id_map;
 };
 
@@ -436,32 +1121,31 @@ class MatrixLoader : public OmicsLoader {
                const std::string& sample_map)
       : OmicsLoader(workspace, array, file_list, sample_map) {
     if (!m_array_metadata->is_initialized()) m_array_metadata->update_metadata(default_metadata());
+    m_split_unsorted_input = true;
+    m_bulk_rows = true;
   }
   virtual void create_schema() override;
   virtual void import() override;
+  void configure(const OmicsDSImportConfig& config) override;
+  // dense arrays are cut in tiles of whole features, see OmicsDSImportConfig::dense
+  OmicsArrayLayout plan_layout() override;
 
   extents_t get_extent(Dimension dimension);
   extents_t expand_extent(Dimension dimension, size_t value);
 
  protected:
+  // dense arrays hold the score of every feature and sample row, in blocks of features written as
+  // fragments of their own. Features are indexed in the order they are merged, all the versions of
+  // an id go in the same block, and cells missing from the files hold NaN
+  bool m_dense = false;
+  int64_t m_dense_samples = 0;
+  std::vector<gtf_encoding_t> m_dense_features;
+  void merge_dense();
   static std::shared_ptr<ArrayMetadata> default_metadata();
   static void generate_default_extent(DimensionExtent* dimension_extent, Dimension* dimension);
   virtual void add_reader(const std::string& filename) override;
 };
 
-class MatrixCell : public OmicsCell {
- public:
-  MatrixCell(std::array<int64_t, 2> coords, int8_t version, std::shared_ptr<OmicsSchema> schema,
-             int file_idx)
-      : OmicsCell(coords, schema, file_idx) {
-    m_version = version;
-  }
-  uint8_t get_version() { return m_version; }
-
- private:
-  uint8_t m_version = 0;
-};
-
 /**
  * Returns an OmicsLoader corresponding to the specified configuration
  */
@@ -44,8 +44,8 @@ class OmicsDSModule {
     m_array_storage->initialize();
   }
 
-  // Constructor for initial loading/importing operations
-  // TODO: Support incremental loading/importing
+  // Constructor for loading/importing operations, see OmicsLoader::initialize for appending to an
+  // existing array
   OmicsDSModule(std::string_view workspace, std::string_view array, std::string_view mapping_file,
                 bool position_major)
       : m_array_storage(std::make_shared<TileDBArrayStorage>(workspace, array)),
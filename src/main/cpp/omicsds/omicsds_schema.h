@@ -28,6 +28,9 @@
 #pragma once
 
 #include <array>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
 #include <iostream>
 #include <map>
 #include <memory>
@@ -57,6 +60,11 @@ class GenomicMap {
   uint64_t flatten(std::string contig_name, uint64_t offset);
   // reverse of flatten
   std::pair<std::string, uint64_t> unflatten(uint64_t position);
+  // length of contig_name, 0 if it is not in the map
+  uint64_t contig_length(const std::string& contig_name) const;
+  // flattened starting positions of the contigs followed by the end of the last contig, in
+  // increasing order. Empty if there are no contigs
+  std::vector<uint64_t> contig_boundaries() const;
   // human readably serialize contig information
   // used as subset of serialized schema
   void serialize(std::string path);
@@ -172,6 +180,34 @@ struct OmicsFieldInfo {
     return std::to_string(length);
   }
 
+  // whether T is the type of the elements of this field
+  template <class T>
+  bool holds() const {
+    switch (type) {
+      case omics_char:
+        return std::is_same<T, char>::value;
+      case omics_uint8_t:
+        return std::is_same<T, uint8_t>::value;
+      case omics_int8_t:
+        return std::is_same<T, int8_t>::value;
+      case omics_uint16_t:
+        return std::is_same<T, uint16_t>::value;
+      case omics_int16_t:
+        return std::is_same<T, int16_t>::value;
+      case omics_uint32_t:
+        return std::is_same<T, uint32_t>::value;
+      case omics_int32_t:
+        return std::is_same<T, int32_t>::value;
+      case omics_uint64_t:
+        return std::is_same<T, uint64_t>::value;
+      case omics_int64_t:
+        return std::is_same<T, int64_t>::value;
+      case omics_float_t:
+        return std::is_same<T, float>::value;
+    }
+    return false;
+  }
+
   size_t element_size() {
     switch (type) {
       case omics_char:
@@ -203,6 +239,9 @@ struct OmicsFieldInfo {
   bool operator==(const OmicsFieldInfo& o) { return type == o.type && length == o.length; }
 };
 
+template <class T>
+struct FieldSlot;
+
 // schema for array
 // contains attributes and a GenomicMap
 struct OmicsSchema {
@@ -235,6 +274,10 @@ struct OmicsSchema {
   // get index of attribute by name
   // useful because fields in OmicsCell are in the same order as in OmicsSchema
   int index_of_attribute(const std::string& name);
+  // typed handle to attribute name, to be resolved once outside of loops over cells
+  // the slot is invalid if name is not in the schema, debug builds check that T matches its type
+  template <class T>
+  FieldSlot<T> slot(const std::string& name);
 };
 
 bool equivalent_schema(const OmicsSchema& l, const OmicsSchema& r);
@@ -262,9 +305,9 @@ struct OmicsFieldData {
   template <typename T>
   void push_pointer_back(const T* elem_ptr, size_t length) {
     static_assert(std::is_integral<T>::value, "Only Integral types can be specified.");
-    for (auto i = 0ul; i < length; i++) {
-      push_back(*(elem_ptr + i));
-    }
+    auto size = data.size();
+    data.resize(size + length * sizeof(T));
+    memcpy(data.data() + size, elem_ptr, length * sizeof(T));
   }
 
   template <class T>
@@ -283,3 +326,34 @@ struct OmicsFieldData {
     return data.size() / sizeof(T);
   }
 };
+
+// pre-resolved typed handle to an attribute of an OmicsSchema, see OmicsSchema::slot
+// indexes fields of cells directly, e.g. FieldSlot<int32_t> pos = schema.slot<int32_t>("POS")
+template <class T>
+struct FieldSlot {
+  typedef T value_type;
+
+  int idx = -1;  // index of the attribute in schema order, negative if not in the schema
+
+  bool valid() const { return idx >= 0; }
+
+  // typed access to the field of this slot in data, as passed to OmicsExporter callbacks
+  const T* ptr(const std::vector<OmicsFieldData>& data) const { return data[idx].get_ptr<T>(); }
+  size_t size(const std::vector<OmicsFieldData>& data) const {
+    return data[idx].typed_size<T>();
+  }
+  T get(const std::vector<OmicsFieldData>& data, size_t i = 0) const {
+    return data[idx].get<T>(i);
+  }
+};
+
+template <class T>
+FieldSlot<T> OmicsSchema::slot(const std::string& name) {
+  FieldSlot<T> slot;
+  auto it = attributes.find(name);
+  if (it != attributes.end()) {
+    assert(it->second.holds<T>() && "FieldSlot type does not match the type of the attribute");
+    slot.idx = std::distance(attributes.begin(), it);
+  }
+  return slot;
+}
@@ -27,9 +27,13 @@
 
 #pragma once
 
+#include "omicsds_compression.h"
 #include "omicsds_schema.h"
 
+#include <algorithm>
+#include <array>
 #include <functional>
+#include <limits>
 #include <string>
 
 // TODO Move the FileSystem operations here
@@ -40,6 +44,49 @@ typedef std::function<void(const std::array<uint64_t, 3>& coords,
                            const std::vector<OmicsFieldData>& data)>
     process_cell_t;
 
+// a chunk of the cells read by retrieve_by_batch, as columns. Attributes are in schema order, the
+// values of fixed length ones are length elements per cell and those of variable length ones come
+// with the offset of every cell into them, as in the buffers passed to store. Coordinates are in
+// standard order, LEVEL is 0 for arrays without it
+struct OmicsColumns {
+  size_t cells = 0;
+  std::vector<void*> values;
+  std::vector<size_t> value_sizes;  // in bytes
+  std::vector<size_t*> offsets;     // null for fixed length attributes
+  std::vector<uint64_t> samples, positions, levels;
+
+  template <class T>
+  T* column(const FieldSlot<T>& slot) const {
+    return static_cast<T*>(values[slot.idx]);
+  }
+  // elements of cell in the variable length attribute of slot
+  template <class T>
+  std::pair<T*, size_t> cell(const FieldSlot<T>& slot, size_t cell) const {
+    size_t begin = offsets[slot.idx][cell];
+    size_t end = cell + 1 < cells ? offsets[slot.idx][cell + 1] : value_sizes[slot.idx];
+    return {reinterpret_cast<T*>(static_cast<uint8_t*>(values[slot.idx]) + begin),
+            (end - begin) / sizeof(T)};
+  }
+};
+
+typedef std::function<void(OmicsColumns& columns)> process_batch_t;
+
+// physical layout of an array, planned by the loader that creates it
+struct OmicsArrayLayout {
+  // dense arrays hold a cell at every coordinate of their two dimensions, POSITION and SAMPLE in
+  // schema order, and are written with store_subarray. Sparse arrays have a third LEVEL dimension
+  // for the cells that share coordinates
+  bool dense = false;
+  // low and high bounds of the dimensions in schema order, those of LEVEL last
+  std::array<int64_t, 6> domain = {0, std::numeric_limits<int64_t>::max(),
+                                   0, std::numeric_limits<int64_t>::max(),
+                                   0, std::numeric_limits<int16_t>::max()};
+  // dense arrays are cut in regular tiles of tile_extents cells, sparse arrays in data tiles of
+  // capacity cells
+  std::array<int64_t, 2> tile_extents = {0, 0};
+  int64_t capacity = 1024;
+};
+
 class OmicsDSArrayStorage {
  public:
   OmicsDSArrayStorage(std::string_view workspace = "workspace", std::string_view array = "array")
@@ -61,19 +108,53 @@ class OmicsDSArrayStorage {
                           bool overwrite_workspace, bool overwrite_array) {}
   virtual void finalize() {}
 
+  // see OmicsArrayLayout. Only used when initialize creates the array
+  void set_layout(const OmicsArrayLayout& layout) { m_layout = layout; }
+
+  // compression of the attributes, coordinates and offsets, see OmicsCompressionMap. Those missing
+  // from compression are not compressed. Only used when initialize creates the array
+  void set_compression(const OmicsCompressionMap& compression) { m_compression = compression; }
+
   virtual void reopen_array() {}
 
   virtual int store(std::vector<void*>& buffers, std::vector<size_t>& buffer_sizes) { return 0; }
+  // writes the attributes of every cell of subarray (low and high bounds of both dimensions) of a
+  // dense array, in row major order
+  virtual int store_subarray(std::vector<void*>& buffers, std::vector<size_t>& buffer_sizes,
+                             const std::array<int64_t, 4>& subarray) {
+    return 0;
+  }
   virtual int retrieve(std::vector<void*>& buffers, std::vector<size_t>& buffer_sizes) { return 0; }
   virtual int retrieve_by_cell(std::vector<void*>& buffers, std::vector<size_t>& buffer_sizes,
                                int64_t* subarray, process_cell_t processor) {
     return 0;
   }
+  // passes the cells in subarray to processor a chunk at a time, read into buffers of buffer_size
+  // bytes that grow when a single cell does not fit
+  virtual int retrieve_by_batch(int64_t* subarray, size_t buffer_size, process_batch_t processor) {
+    return 0;
+  }
   virtual int consolidate() { return 0; }
 
   virtual int to_field_type(OmicsFieldInfo::OmicsFieldType omics_type) { return omics_type; }
 
+  // arrays are created with the domain planned by their import, queries are kept within it. Sets
+  // bounds to the low and high bounds of the dims dimensions of subarray clamped to domain, false if
+  // subarray is outside of the domain
+  static bool within_domain(const int64_t* domain, int dims, const int64_t* subarray,
+                            std::vector<int64_t>& bounds) {
+    bounds.assign(subarray, subarray + 2 * dims);
+    for (auto i = 0; i < 2 * dims; i += 2) {
+      bounds[i] = std::max(bounds[i], domain[i]);
+      bounds[i + 1] = std::min(bounds[i + 1], domain[i + 1]);
+      if (bounds[i] > bounds[i + 1]) return false;
+    }
+    return true;
+  }
+
  protected:
   std::string m_workspace;
   std::string m_array;
+  OmicsArrayLayout m_layout;
+  OmicsCompressionMap m_compression;
 };
@@ -35,8 +35,11 @@
 #include "tiledb_utils.h"
 
 void TileDBArrayStorage::configure_workspace() {
-  check(TileDBUtils::create_workspace(m_workspace, /*replace*/ true),
-        "Could not create workspace={}", m_workspace);
+  // keep an existing workspace, appends import into the arrays already there
+  if (!TileDBUtils::workspace_exists(m_workspace)) {
+    check(TileDBUtils::create_workspace(m_workspace, /*replace*/ false),
+          "Could not create workspace={}", m_workspace);
+  }
 }
 
 void TileDBArrayStorage::initialize(bool write_mode, std::shared_ptr<OmicsSchema> omicsds_schema,
@@ -100,25 +103,29 @@ void TileDBArrayStorage::initialize(bool write_mode, std::shared_ptr<OmicsSchema
           dimensions[1] = "POSITION";
         }
 
-        // low/high limits per dimension
-        int64_t domain[] = {
-            0,
-            std::numeric_limits<int64_t>::max(),  // 1st dimension limits (SAMPLE or POSITION
-            // based on order)
-            0,
-            std::numeric_limits<int64_t>::max(),  // 2nd dimension limits
-            0,
-            std::numeric_limits<int16_t>::max()  // Level limits
-        };
-
-        std::vector<int32_t> compression_vec(omicsds_schema->attributes.size() + 1,
-                                             TILEDB_NO_COMPRESSION);  // +1 for coordinates
-        const int* compression = compression_vec.data();
+        // low/high limits per dimension, dense arrays have no levels and their cells are stored
+        // without coordinates
+        const int64_t* domain = m_layout.domain.data();
+        int num_dimensions = m_layout.dense ? 2 : 3;
 
-        // TODO : Should get offset compression from protobuf configuration
-        std::vector<int32_t> offsets_compression_vec(omicsds_schema->attributes.size(),
-                                                     TILEDB_NO_COMPRESSION);
+        // +1 for coordinates
+        std::vector<int32_t> compression_vec, compression_level_vec;
+        std::vector<int32_t> offsets_compression_vec, offsets_compression_level_vec;
+        for (auto const& attribute : omicsds_schema->attributes) {
+          auto [type, level] = to_compression(attribute.first);
+          compression_vec.push_back(type);
+          compression_level_vec.push_back(level);
+          std::tie(type, level) = to_compression(OmicsCompressionNames::OFFSETS);
+          offsets_compression_vec.push_back(type);
+          offsets_compression_level_vec.push_back(level);
+        }
+        auto [coords_type, coords_level] = to_compression(OmicsCompressionNames::COORDS);
+        compression_vec.push_back(coords_type);
+        compression_level_vec.push_back(coords_level);
+        const int* compression = compression_vec.data();
+        const int* compression_level = compression_level_vec.data();
         const int* offsets_compression = offsets_compression_vec.data();
+        const int* offsets_compression_level = offsets_compression_level_vec.data();
 
         // Set array schema
         TileDB_ArraySchema tiledb_array_schema;
@@ -126,22 +133,22 @@ void TileDBArrayStorage::initialize(bool write_mode, std::shared_ptr<OmicsSchema
                                       m_array_path.c_str(),               // Array name
                                       attributes,                         // Attributes
                                       omicsds_schema->attributes.size(),  // Number of attributes
-                                      1024,                               // Capacity
+                                      m_layout.capacity,                  // Capacity
                                       order,                              // Cell order
                                       cell_val_num,         // Number of cell values per attribute
                                       compression,          // Compression
-                                      NULL,                 // Compression level - Use defaults
+                                      compression_level,    // Compression level
                                       offsets_compression,  // Offsets compression
-                                      NULL,                 // Offsets compression level
-                                      0,                    // Sparse array
+                                      offsets_compression_level,  // Offsets compression level
+                                      m_layout.dense,       // Sparse or dense array
                                       dimensions,           // Dimensions
-                                      3,                    // Number of dimensions
+                                      num_dimensions,       // Number of dimensions
                                       domain,               // Domain
-                                      6 * sizeof(int64_t),  // Domain length in bytes
-                                      NULL,   // Tile extents (no regular tiles defined)
-                                      0,      // Tile extents in bytes
-                                      order,  // Tile order
-                                      types   // Types
+                                      2 * num_dimensions * sizeof(int64_t),  // Domain length
+                                      m_layout.dense ? m_layout.tile_extents.data() : NULL,
+                                      m_layout.dense ? sizeof(m_layout.tile_extents) : 0,
+                                      order,                                 // Tile order
+                                      types                                  // Types
                                       ),
               "Could not set TileDB array schema for array={}", m_array_path);
 
@@ -204,6 +211,21 @@ int TileDBArrayStorage::store(std::vector<void*>& buffers, std::vector<size_t>&
   return OMICSDS_OK;
 }
 
+int TileDBArrayStorage::store_subarray(std::vector<void*>& buffers,
+                                       std::vector<size_t>& buffer_sizes,
+                                       const std::array<int64_t, 4>& subarray) {
+  // the cells of the subarray are written as a fragment of their own
+  TileDB_Array* tiledb_array = nullptr;
+  check(tiledb_array_init(m_tiledb_ctx, &tiledb_array, m_array_path.c_str(),
+                          TILEDB_ARRAY_WRITE_SORTED_ROW, subarray.data(), NULL, 0),
+        "Could not initialize TileDB array={} for writing a subarray", m_array_path);
+  check(tiledb_array_write(tiledb_array, const_cast<const void**>(buffers.data()),
+                           buffer_sizes.data()),
+        "Could not store subarray from buffers into TileDB for array={}", m_array_path);
+  check(tiledb_array_finalize(tiledb_array), "Could not finalize TileDB array={}", m_array_path);
+  return OMICSDS_OK;
+}
+
 int TileDBArrayStorage::retrieve(std::vector<void*>& buffers, std::vector<size_t>& buffer_sizes) {
   check(tiledb_array_read(m_tiledb_array, buffers.data(), buffer_sizes.data()),
         "Could not retrieve into buffers from TileDB for array={}", m_array_path);
@@ -224,16 +246,32 @@ int TileDBArrayStorage::retrieve_by_cell(std::vector<void*>& buffers,
 
   check(tiledb_array_finalize(m_tiledb_array), "Failed to finalize array path={}", m_array_path);
 
+  // the coordinates of dense arrays are only computed when asked for, after the attributes
+  bool dense = tiledb_array_schema.dense_;
+  std::vector<const char*> attribute_names;
+  if (dense) {
+    attribute_names.assign(tiledb_array_schema.attributes_,
+                           tiledb_array_schema.attributes_ + tiledb_array_schema.attribute_num_);
+    attribute_names.push_back(TILEDB_COORDS);
+  }
+
+  std::vector<int64_t> bounds;
+  if (!within_domain(static_cast<const int64_t*>(tiledb_array_schema.domain_),
+                     tiledb_array_schema.dim_num_, subarray, bounds)) {
+    open_array(false);
+    return OMICSDS_OK;
+  }
+
   TileDB_ArrayIterator* tiledb_array_it;
   check(tiledb_array_iterator_init(m_tiledb_ctx,          // Context
                                    &tiledb_array_it,      // Array iterator
                                    m_array_path.c_str(),  // Array name
                                    TILEDB_ARRAY_READ,     // Mode
-                                   subarray,              // Constrain in subarray
-                                   NULL,                  // All attributes
-                                   0,                     // Number of attributes
-                                   buffers.data(),        // Buffers used internally
-                                   buffer_sizes.data()),  // Buffer sizes
+                                   bounds.data(),         // Constrain in subarray
+                                   dense ? attribute_names.data() : NULL,  // Attributes
+                                   attribute_names.size(),  // Number of attributes, 0 for all
+                                   buffers.data(),          // Buffers used internally
+                                   buffer_sizes.data()),    // Buffer sizes
         "Could not initialize TileDB iterator for array={}", m_array_path);
 
   // Set up field data and presize the non-variable sized data fields for callback
@@ -273,7 +311,7 @@ int TileDBArrayStorage::retrieve_by_cell(std::vector<void*>& buffers,
               &a1_size),                  // Value size (useful in variable-sized attributes)
           "Failed to get coords value from TileDB iterator for array={}", m_array_path);
 
-    coords = {coords_ptr[0], coords_ptr[1], coords_ptr[2]};
+    coords = {coords_ptr[0], coords_ptr[1], dense ? 0 : coords_ptr[2]};
     if (strncmp(tiledb_array_schema.dimensions_[0], "POSITION", 8) == 0) {
       std::swap(coords[0], coords[1]);
     }
@@ -293,12 +331,190 @@ int TileDBArrayStorage::retrieve_by_cell(std::vector<void*>& buffers,
   return OMICSDS_OK;
 }
 
+int TileDBArrayStorage::retrieve_by_batch(int64_t* subarray, size_t buffer_size,
+                                          process_batch_t processor) {
+  TileDB_ArraySchema tiledb_array_schema = {};
+  check(tiledb_array_get_schema(m_tiledb_array, &tiledb_array_schema),
+        "Could not get TileDB schema for array={}", m_array_path);
+
+  check(tiledb_array_finalize(m_tiledb_array), "Failed to finalize array path={}", m_array_path);
+
+  std::vector<int64_t> bounds;
+  if (!within_domain(static_cast<const int64_t*>(tiledb_array_schema.domain_),
+                     tiledb_array_schema.dim_num_, subarray, bounds)) {
+    open_array(false);
+    return OMICSDS_OK;
+  }
+
+  // coordinates are asked for explicitly, dense arrays only compute them when asked for
+  auto attributes = tiledb_array_schema.attribute_num_;
+  std::vector<const char*> attribute_names(tiledb_array_schema.attributes_,
+                                           tiledb_array_schema.attributes_ + attributes);
+  attribute_names.push_back(TILEDB_COORDS);
+
+  TileDB_Array* tiledb_array;
+  check(tiledb_array_init(m_tiledb_ctx,             // Context
+                          &tiledb_array,            // Array object
+                          m_array_path.c_str(),     // Array name
+                          TILEDB_ARRAY_READ,        // Mode
+                          bounds.data(),            // Constrain in subarray
+                          attribute_names.data(),   // Attributes
+                          attribute_names.size()),  // Number of attributes
+        "Could not initialize TileDB array={} for reading batches", m_array_path);
+
+  // a buffer per fixed length attribute, offsets and values per variable length one, then one for
+  // the coordinates. Buffers of attribute i start at first_buffer[i], those of fixed length hold
+  // cell_bytes per cell
+  int dimensions = tiledb_array_schema.dim_num_;
+  std::vector<size_t> first_buffer = {0};
+  std::vector<size_t> cell_bytes;
+  for (auto i = 0; i < attributes; i++) {
+    auto length = tiledb_array_schema.cell_val_num_[i];
+    bool variable = length == TILEDB_VAR_NUM;
+    if (variable) cell_bytes.push_back(sizeof(size_t));
+    cell_bytes.push_back(variable ? 0 : length * tiledb_type_size[tiledb_array_schema.types_[i]]);
+    first_buffer.push_back(cell_bytes.size());
+  }
+  cell_bytes.push_back(dimensions * sizeof(int64_t));
+  first_buffer.push_back(cell_bytes.size());
+  auto num_buffers = cell_bytes.size();
+  std::vector<std::vector<uint8_t>> buffers(num_buffers, std::vector<uint8_t>(buffer_size));
+  std::vector<size_t> filled(num_buffers, 0);
+  std::vector<void*> pointers(num_buffers);
+  std::vector<size_t> sizes(num_buffers);
+
+  int sample_dimension = strncmp(tiledb_array_schema.dimensions_[0], "POSITION", 8) == 0 ? 1 : 0;
+  OmicsColumns columns;
+  columns.values.resize(attributes);
+  columns.value_sizes.resize(attributes);
+  columns.offsets.resize(attributes);
+
+  // TileDB reads every attribute on its own and those that overflow resume where they stopped, so
+  // the buffers can hold different numbers of cells. Chunks end with the shortest one, the cells
+  // read past it are kept at the front of their buffers for the next chunk
+  bool overflow;
+  do {
+    for (auto i = 0u; i < num_buffers; i++) {
+      pointers[i] = buffers[i].data() + filled[i];
+      sizes[i] = buffers[i].size() - filled[i];
+    }
+    check(tiledb_array_read(tiledb_array, pointers.data(), sizes.data()),
+          "Could not read from TileDB array={}", m_array_path);
+
+    overflow = false;
+    columns.cells = std::numeric_limits<size_t>::max();
+    for (auto i = 0; i <= attributes; i++) {
+      auto buffer = first_buffer[i];
+      if (first_buffer[i + 1] - buffer == 2) {  // offsets of the read start at its values
+        auto offsets = reinterpret_cast<size_t*>(pointers[buffer]);
+        for (auto j = 0u; j < sizes[buffer] / sizeof(size_t); j++) {
+          offsets[j] += filled[buffer + 1];
+        }
+      }
+      for (auto j = buffer; j < first_buffer[i + 1]; j++) {
+        filled[j] += sizes[j];
+      }
+      columns.cells = std::min(columns.cells, filled[buffer] / cell_bytes[buffer]);
+
+      // buffers too small for a single cell are grown before reading again
+      if (tiledb_array_overflow(tiledb_array, i)) {
+        overflow = true;
+        for (auto j = buffer; j < first_buffer[i + 1] && filled[buffer] < cell_bytes[buffer]; j++) {
+          buffers[j].resize(2 * buffers[j].size());
+        }
+      }
+    }
+    if (!columns.cells) continue;
+
+    for (auto i = 0; i < attributes; i++) {
+      auto buffer = first_buffer[i];
+      if (first_buffer[i + 1] - buffer == 2) {
+        auto offsets = reinterpret_cast<size_t*>(buffers[buffer].data());
+        columns.offsets[i] = offsets;
+        columns.values[i] = buffers[buffer + 1].data();
+        columns.value_sizes[i] = columns.cells < filled[buffer] / sizeof(size_t)
+                                     ? offsets[columns.cells]
+                                     : filled[buffer + 1];
+      } else {
+        columns.offsets[i] = nullptr;
+        columns.values[i] = buffers[buffer].data();
+        columns.value_sizes[i] = columns.cells * cell_bytes[buffer];
+      }
+    }
+    auto coords = reinterpret_cast<const int64_t*>(buffers.back().data());
+    columns.samples.resize(columns.cells);
+    columns.positions.resize(columns.cells);
+    columns.levels.assign(columns.cells, 0);
+    for (auto cell = 0u; cell < columns.cells; cell++, coords += dimensions) {
+      columns.samples[cell] = coords[sample_dimension];
+      columns.positions[cell] = coords[1 - sample_dimension];
+      if (dimensions > 2) columns.levels[cell] = coords[2];
+    }
+    processor(columns);
+
+    // drop the cells of the chunk, offsets of those kept are moved down with their values
+    for (auto i = 0; i <= attributes; i++) {
+      auto buffer = first_buffer[i];
+      size_t used = columns.cells * cell_bytes[buffer];
+      if (first_buffer[i + 1] - buffer == 2) {
+        size_t values = columns.value_sizes[i];
+        auto offsets = reinterpret_cast<size_t*>(buffers[buffer].data());
+        for (auto j = columns.cells; j < filled[buffer] / sizeof(size_t); j++) {
+          offsets[j] -= values;
+        }
+        auto& data = buffers[buffer + 1];
+        memmove(data.data(), data.data() + values, filled[buffer + 1] - values);
+        filled[buffer + 1] -= values;
+      }
+      auto& data = buffers[buffer];
+      memmove(data.data(), data.data() + used, filled[buffer] - used);
+      filled[buffer] -= used;
+    }
+  } while (overflow);
+
+  check(tiledb_array_finalize(tiledb_array), "Failed to finalize array path={}", m_array_path);
+
+  open_array(false);
+
+  return OMICSDS_OK;
+}
+
 int TileDBArrayStorage::consolidate() {
   check(tiledb_array_consolidate(m_tiledb_ctx, m_array_path.c_str()),
         "Failed to consolidate TileDB array {}", m_array_path);
   return OMICSDS_OK;
 }
 
+std::pair<int, int> TileDBArrayStorage::to_compression(const std::string& name) {
+  auto it = m_compression.find(name);
+  if (it == m_compression.end()) {
+    return {TILEDB_NO_COMPRESSION, 0};
+  }
+  auto& compression = it->second;
+  int type = TILEDB_NO_COMPRESSION;
+  int level = compression.level;
+  switch (compression.codec) {
+    case OmicsCompression::NONE:
+      break;
+    case OmicsCompression::GZIP:
+      type = TILEDB_GZIP;
+      if (!level) level = TILEDB_COMPRESSION_LEVEL_GZIP;
+      break;
+    case OmicsCompression::ZSTD:
+      type = TILEDB_ZSTD;
+      if (!level) level = TILEDB_COMPRESSION_LEVEL_ZSTD;
+      break;
+    case OmicsCompression::LZ4:
+      type = TILEDB_LZ4;  // has no levels
+      break;
+  }
+  // delta encoding is applied to the tiles before they are compressed
+  if (compression.delta) {
+    type += TILEDB_DELTA_ENCODE;
+  }
+  return {type, level};
+}
+
 int TileDBArrayStorage::to_field_type(OmicsFieldInfo::OmicsFieldType omics_type) {
   switch (omics_type) {
     case OmicsFieldInfo::omics_char:
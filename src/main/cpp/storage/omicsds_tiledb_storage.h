@@ -49,13 +49,19 @@ class TileDBArrayStorage : public OmicsDSArrayStorage, public OmicsDSTileDBUtils
   void reopen_array() override;
 
   int store(std::vector<void*>& buffers, std::vector<size_t>& buffer_sizes) override;
+  int store_subarray(std::vector<void*>& buffers, std::vector<size_t>& buffer_sizes,
+                     const std::array<int64_t, 4>& subarray) override;
   int retrieve(std::vector<void*>& buffers, std::vector<size_t>& buffer_sizes) override;
   int retrieve_by_cell(std::vector<void*>& buffers, std::vector<size_t>& buffer_sizes,
                        int64_t* subarray, process_cell_t processor) override;
+  int retrieve_by_batch(int64_t* subarray, size_t buffer_size,
+                        process_batch_t processor) override;
 
   int consolidate() override;
 
   int to_field_type(OmicsFieldInfo::OmicsFieldType omics_type) override;
+  // compression type and level of the TileDB schema for the entry name of m_compression
+  std::pair<int, int> to_compression(const std::string& name);
 
  private:
   void open_array(bool write_mode);
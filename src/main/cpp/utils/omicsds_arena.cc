@@ -0,0 +1,101 @@
+/**
+ * @file   omicsds_arena.cc
+ *
+ * @section LICENSE
+ *
+ * The MIT License
+ *
+ * @copyright Copyright (c) 2022 Omics Data Automation, Inc.
+ * @copyright Copyright (c) 2023 dātma, inc™
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * @section DESCRIPTION
+ *
+ * Implementation of the bump allocator backing cell payloads during import
+ */
+
+#include "omicsds_arena.h"
+
+#include <algorithm>
+#include <cstring>
+
+uint8_t* OmicsArena::allocate(size_t bytes, uint32_t* block) {
+  size_t aligned = (bytes + 7) & ~size_t(7);
+  if (m_blocks.empty() || m_blocks[m_current].used + aligned > m_blocks[m_current].size) {
+    next_block(aligned);
+  }
+  auto& current = m_blocks[m_current];
+  uint8_t* ptr = current.data.get() + current.used;
+  current.used += aligned;
+  current.live++;
+  if (block) *block = m_current;
+  return ptr;
+}
+
+uint8_t* OmicsArena::append(const void* ptr, size_t bytes, uint32_t* block) {
+  uint8_t* dst = allocate(bytes, block);
+  if (bytes) memcpy(dst, ptr, bytes);
+  return dst;
+}
+
+void OmicsArena::release(uint32_t block) {
+  auto& released = m_blocks[block];
+  if (--released.live == 0) {
+    released.used = 0;
+    if (block != m_current) {
+      m_free_blocks.push_back(block);
+    }
+  }
+}
+
+void OmicsArena::reset() {
+  m_free_blocks.clear();
+  for (auto i = 0u; i < m_blocks.size(); i++) {
+    m_blocks[i].used = 0;
+    m_blocks[i].live = 0;
+    if (i != m_current) {
+      m_free_blocks.push_back(i);
+    }
+  }
+}
+
+void OmicsArena::next_block(size_t bytes) {
+  // the current block goes back to the free list if nothing in it is live any more
+  if (!m_blocks.empty() && m_blocks[m_current].live == 0) {
+    m_blocks[m_current].used = 0;
+    if (m_blocks[m_current].size >= bytes) return;
+    m_free_blocks.push_back(m_current);
+  }
+
+  for (auto it = m_free_blocks.begin(); it != m_free_blocks.end(); it++) {
+    if (m_blocks[*it].size >= bytes) {
+      m_current = *it;
+      m_free_blocks.erase(it);
+      return;
+    }
+  }
+
+  Block block;
+  block.size = std::max(bytes, m_block_size);
+  block.data = std::make_unique<uint8_t[]>(block.size);
+  m_capacity += block.size;
+  m_current = m_blocks.size();
+  m_blocks.push_back(std::move(block));
+}
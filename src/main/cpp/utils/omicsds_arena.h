@@ -0,0 +1,100 @@
+/**
+ * @file   omicsds_arena.h
+ *
+ * @section LICENSE
+ *
+ * The MIT License
+ *
+ * @copyright Copyright (c) 2022 Omics Data Automation, Inc.
+ * @copyright Copyright (c) 2023 dātma, inc™
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * @section DESCRIPTION
+ *
+ * Header file for the bump allocator backing cell payloads during import
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/**
+ * Bump allocator for short lived import data, e.g. the fields of cells between parsing and
+ * buffering them for storage.
+ *
+ * Memory is handed out from large blocks by bumping an offset, so an allocation is a pointer
+ * increment and individual allocations are never freed. Blocks are recycled instead, either all at
+ * once with reset() or one at a time when every allocation from a block has been released. Pointers
+ * stay valid until their block is recycled, blocks never move.
+ */
+class OmicsArena {
+ public:
+  static const size_t default_block_size = 1024 * 1024;
+
+  OmicsArena(size_t block_size = default_block_size) : m_block_size(block_size) {}
+  OmicsArena(const OmicsArena&) = delete;
+  OmicsArena& operator=(const OmicsArena&) = delete;
+  OmicsArena(OmicsArena&&) = default;
+  OmicsArena& operator=(OmicsArena&&) = default;
+
+  /**
+   * Returns bytes of uninitialized memory aligned to 8 bytes. If block is not null, it is set to
+   * the handle to be passed to release() once the allocation is no longer needed.
+   */
+  uint8_t* allocate(size_t bytes, uint32_t* block = nullptr);
+
+  /**
+   * Same as allocate(), initialized with a copy of bytes from ptr.
+   */
+  uint8_t* append(const void* ptr, size_t bytes, uint32_t* block = nullptr);
+
+  /**
+   * Releases one allocation from block, the block is recycled once all its allocations have been
+   * released. Only needed by callers that do not reset() the arena.
+   */
+  void release(uint32_t block);
+
+  /**
+   * Recycles all blocks, invalidating every allocation. Allocated memory is kept for reuse.
+   */
+  void reset();
+
+  // total bytes held by the arena, in use or not
+  size_t capacity() const { return m_capacity; }
+
+ private:
+  struct Block {
+    std::unique_ptr<uint8_t[]> data;
+    size_t size = 0;
+    size_t used = 0;
+    size_t live = 0;  // allocations not yet released
+  };
+  // makes a block with room for bytes current
+  void next_block(size_t bytes);
+
+  size_t m_block_size;
+  size_t m_capacity = 0;
+  std::vector<Block> m_blocks;
+  std::vector<uint32_t> m_free_blocks;
+  uint32_t m_current = 0;
+};
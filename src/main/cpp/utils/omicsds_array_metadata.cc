@@ -31,6 +31,7 @@
  * Source file for wrapper around array metadata protobuf
  */
 
+#include <algorithm>
 #include <functional>
 
 #include "omicsds_array_metadata.h"
@@ -71,3 +72,40 @@ void OmicsDSArrayMetadata::update_metadata(const std::shared_ptr<ArrayMetadata>
 }
 
 bool OmicsDSArrayMetadata::is_initialized() { return m_initialized; }
+
+bool OmicsDSArrayMetadata::is_dense() { return m_metadata->message()->dense(); }
+
+std::vector<gtf_encoding_t> OmicsDSArrayMetadata::dense_features() {
+  auto message = m_metadata->message();
+  std::vector<gtf_encoding_t> features(message->feature_ids_size());
+  for (auto i = 0; i < message->feature_ids_size(); i++) {
+    features[i] = {message->feature_ids(i), message->feature_versions(i)};
+  }
+  return features;
+}
+
+void OmicsDSArrayMetadata::set_dense(bool dense, const std::vector<gtf_encoding_t>& features) {
+  auto message = m_metadata->message();
+  message->set_dense(dense);
+  message->clear_feature_ids();
+  message->clear_feature_versions();
+  for (auto& feature : features) {
+    message->add_feature_ids(feature.first);
+    message->add_feature_versions(feature.second);
+  }
+}
+
+std::vector<uint64_t> OmicsDSArrayMetadata::sample_rows() {
+  auto message = m_metadata->message();
+  return std::vector<uint64_t>(message->sample_rows().begin(), message->sample_rows().end());
+}
+
+void OmicsDSArrayMetadata::set_sample_rows(std::vector<uint64_t> rows) {
+  std::sort(rows.begin(), rows.end());
+  rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+  auto message = m_metadata->message();
+  message->clear_sample_rows();
+  for (auto row : rows) {
+    message->add_sample_rows(row);
+  }
+}
@@ -35,7 +35,9 @@
 #include <string>
 #include <string_view>
 #include <unordered_map>
+#include <vector>
 
+#include "omicsds_encoder.h"
 #include "omicsds_message_wrapper.h"
 
 // Forward declaration of internal classes
@@ -70,6 +72,31 @@ class OmicsDSArrayMetadata {
    */
   extents_t expand_extent(Dimension dimension, size_t value);
 
+  /**
+   * Whether the array is dense, with the features stored at their index in dense_features.
+   */
+  bool is_dense();
+
+  /**
+   * Encoded ids and versions of the features of a dense array, by index.
+   */
+  std::vector<gtf_encoding_t> dense_features();
+
+  /**
+   * Marks the array as dense with the given features by index, or as sparse if dense is false.
+   */
+  void set_dense(bool dense, const std::vector<gtf_encoding_t>& features = {});
+
+  /**
+   * Sorted sample rows imported into an array of reads or intervals, see OmicsLoader::initialize.
+   */
+  std::vector<uint64_t> sample_rows();
+
+  /**
+   * Replaces the sample rows of the array with rows, which are sorted.
+   */
+  void set_sample_rows(std::vector<uint64_t> rows);
+
  private:
   /**
    * Set up the mapping from from dimensions to extents.
@@ -0,0 +1,101 @@
+/**
+ * @file   omicsds_compression.cc
+ *
+ * @section LICENSE
+ *
+ * The MIT License
+ *
+ * @copyright Copyright (c) 2022 Omics Data Automation, Inc.
+ * @copyright Copyright (c) 2023 dātma, inc™
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * Implementation of the compression of the attributes of arrays
+ */
+
+#include "omicsds_compression.h"
+
+#include <charconv>
+
+static const std::map<std::string_view, OmicsCompression::Codec> codecs = {
+    {"none", OmicsCompression::NONE},
+    {"gzip", OmicsCompression::GZIP},
+    {"zstd", OmicsCompression::ZSTD},
+    {"lz4", OmicsCompression::LZ4}};
+
+std::optional<OmicsCompression> OmicsCompression::parse(std::string_view spec) {
+  OmicsCompression compression;
+  const std::string_view delta_suffix = "+delta";
+  if (spec.size() >= delta_suffix.size() &&
+      spec.substr(spec.size() - delta_suffix.size()) == delta_suffix) {
+    compression.delta = true;
+    spec.remove_suffix(delta_suffix.size());
+  }
+
+  auto colon = spec.find(':');
+  if (colon != std::string_view::npos) {
+    auto level = spec.substr(colon + 1);
+    auto [end, error] =
+        std::from_chars(level.data(), level.data() + level.size(), compression.level);
+    if (error != std::errc() || end != level.data() + level.size() || compression.level < 1) {
+      return std::nullopt;
+    }
+    spec = spec.substr(0, colon);
+  }
+
+  auto codec = codecs.find(spec);
+  if (codec == codecs.end()) {
+    return std::nullopt;
+  }
+  compression.codec = codec->second;
+  return compression;
+}
+
+std::string OmicsCompression::to_string() const {
+  std::string spec;
+  for (auto& [name, value] : codecs) {
+    if (value == codec) spec = name;
+  }
+  if (level) spec += ":" + std::to_string(level);
+  if (delta) spec += "+delta";
+  return spec;
+}
+
+bool parse_compression(std::string_view spec, OmicsCompressionMap& compression) {
+  OmicsCompressionMap parsed;
+  while (!spec.empty()) {
+    auto comma = spec.find(',');
+    auto entry = spec.substr(0, comma);
+    spec = comma == std::string_view::npos ? "" : spec.substr(comma + 1);
+
+    auto equals = entry.find('=');
+    if (equals == 0 || equals == std::string_view::npos) {
+      return false;
+    }
+    auto value = OmicsCompression::parse(entry.substr(equals + 1));
+    if (!value) {
+      return false;
+    }
+    parsed[std::string(entry.substr(0, equals))] = *value;
+  }
+  for (auto& [name, value] : parsed) {
+    compression[name] = value;
+  }
+  return true;
+}
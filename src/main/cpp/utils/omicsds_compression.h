@@ -0,0 +1,81 @@
+/**
+ * @file   omicsds_compression.h
+ *
+ * @section LICENSE
+ *
+ * The MIT License
+ *
+ * @copyright Copyright (c) 2022 Omics Data Automation, Inc.
+ * @copyright Copyright (c) 2023 dātma, inc™
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * Header file for the compression of the attributes of arrays
+ */
+
+#pragma once
+
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+
+/**
+ * Compression of the tiles of an attribute, of the coordinates or of the offsets of variable length
+ * attributes. Integers that mostly increase, like coordinates and offsets, compress better when
+ * they are delta encoded first.
+ */
+struct OmicsCompression {
+  enum Codec { NONE, GZIP, ZSTD, LZ4 };
+  Codec codec = NONE;
+  int level = 0;  // 0 for the default level of the codec
+  bool delta = false;
+
+  OmicsCompression(Codec codec = NONE, int level = 0, bool delta = false)
+      : codec(codec), level(level), delta(delta) {}
+
+  /**
+   * Parses codec[:level][+delta] with codec one of none, gzip, zstd or lz4, e.g. zstd:9 or
+   * lz4+delta. Returns nullopt if spec is not valid.
+   */
+  static std::optional<OmicsCompression> parse(std::string_view spec);
+
+  std::string to_string() const;
+
+  bool operator==(const OmicsCompression& other) const {
+    return codec == other.codec && level == other.level && delta == other.delta;
+  }
+};
+
+/**
+ * Compression of the attributes of an array by name, the coordinates and the offsets of all the
+ * variable length attributes are named by COORDS and OFFSETS.
+ */
+typedef std::map<std::string, OmicsCompression> OmicsCompressionMap;
+
+namespace OmicsCompressionNames {
+const std::string COORDS = "COORDS";
+const std::string OFFSETS = "OFFSETS";
+}  // namespace OmicsCompressionNames
+
+/**
+ * Parses comma separated name=compression entries into compression, replacing the entries of the
+ * same names. Returns false, leaving compression unchanged, if an entry is not valid.
+ */
+bool parse_compression(std::string_view spec, OmicsCompressionMap& compression);
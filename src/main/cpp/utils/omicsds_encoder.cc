@@ -35,7 +35,9 @@
 #include "omicsds_logger.h"
 
 #include <cmath>
+#include <mutex>
 #include <regex>
+#include <shared_mutex>
 
 /**
  * The gene/transcript ids in the Homo_sapiens.GRCh37.87.gtf seem to follow a pattern. e.g.
@@ -53,13 +55,15 @@ static std::map<uint8_t, std::string> decode_kind_of_organism = {{0, ""}, {1, "M
 
 static uint64_t eleven_digit_max = pow(10, 12);
 
-// backing map for encoding
+// backing map for encoding, shared between the threads parsing input files during import
 static std::unordered_map<std::string, gtf_encoding_t> encoding;
+static std::shared_mutex encoding_mutex;
 
 // Cache the last decoded gtf_encoding_t
-static std::pair<gtf_encoding_t, std::string> last_decoding;
+static thread_local std::pair<gtf_encoding_t, std::string> last_decoding;
 
 bool find_encoding(std::string gtf_id, gtf_encoding_t& encoded_gtf) {
+  std::shared_lock<std::shared_mutex> lock(encoding_mutex);
   auto find = encoding.find(gtf_id);
   if (find != encoding.end()) {
     encoded_gtf = find->second;
@@ -94,9 +98,12 @@ gtf_encoding_t encode_gtf_id(std::string gtf_id) {
         }
         version = std::stol(match[5].str());
       }
-      encoding.insert(
-          {gtf_id,
-           {(uint64_t)kind_of_organism << 56 | (uint64_t)type_of_id << 48 | gtf_oll, version}});
+      {
+        std::unique_lock<std::shared_mutex> lock(encoding_mutex);
+        encoding.insert(
+            {gtf_id,
+             {(uint64_t)kind_of_organism << 56 | (uint64_t)type_of_id << 48 | gtf_oll, version}});
+      }
       if (find_encoding(gtf_id, encoded_gtf)) {
         return encoded_gtf;
       } else {
@@ -131,7 +138,10 @@ std::string decode_gtf_id(const gtf_encoding_t& encoded_id) {
     if (encoded_id.second) {
       gtf_id += logger.format(".{}", encoded_id.second);
     }
-    encoding.insert({gtf_id, encoded_id});
+    {
+      std::unique_lock<std::shared_mutex> lock(encoding_mutex);
+      encoding.insert({gtf_id, encoded_id});
+    }
 
     if (encoded_id != last_decoding.first) {
       last_decoding.first = encoded_id;
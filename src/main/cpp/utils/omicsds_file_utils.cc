@@ -76,12 +76,12 @@ bool FileUtility::generalized_getline(std::string& retval) {
   while (chars_read < file_size || str_buffer.size()) {
     size_t idx = str_buffer.find('\n');
     if (idx != std::string::npos) {
-      retval = retval + str_buffer.substr(0, idx);  // exclude newline
-      str_buffer.erase(0, idx + 1);                 // erase newline
+      retval.append(str_buffer, 0, idx);  // exclude newline
+      str_buffer.erase(0, idx + 1);       // erase newline
       return true;
     }
 
-    retval = retval + str_buffer;
+    retval.append(str_buffer);
     str_buffer.clear();
 
     size_t chars_to_read = std::min<size_t>(buffer_size, file_size - chars_read);
@@ -103,18 +103,28 @@ int FileUtility::read_file(void* buffer, size_t chars_to_read) {
     buf_position = read_from_str_buffer(buffer, chars_to_read);
     chars_to_read -= buf_position;
   }
-  check(TileDBUtils::read_file(filename, chars_read, (char*)buffer + buf_position, chars_to_read),
-        "Could not read file {} into buffer", filename);
-  chars_read += chars_to_read;
+  if (chars_to_read) {  // the buffered chars may have been enough
+    check(TileDBUtils::read_file(filename, chars_read, (char*)buffer + buf_position, chars_to_read),
+          "Could not read file {} into buffer", filename);
+    chars_read += chars_to_read;
+  }
   return OMICSDS_OK;
 }
 
 bool FileUtility::is_file(const std::string& path) { return TileDBUtils::is_file(path); }
 
+bool FileUtility::is_dir(const std::string& path) { return TileDBUtils::is_dir(path); }
+
 bool FileUtility::is_workspace(const std::string& workspace) {
   return TileDBUtils::workspace_exists(workspace);
 }
 
+int FileUtility::create_dir(const std::string& path) { return TileDBUtils::create_dir(path); }
+
+int FileUtility::delete_dir(const std::string& path) { return TileDBUtils::delete_dir(path); }
+
+int FileUtility::delete_file(const std::string& path) { return TileDBUtils::delete_file(path); }
+
 int FileUtility::write_file(const std::string& filename, const std::string& str,
                             const bool overwrite) {
   check(TileDBUtils::write_file(filename, str.c_str(), str.size(), overwrite),
@@ -37,9 +37,11 @@ class OmicsDSTileDBUtils {
 
 // Reading/Writing local/cloud files using TileDBUtils api
 struct FileUtility : public OmicsDSTileDBUtils {
+  static constexpr size_t default_buffer_size = 1024 * 1024 * 8;
+
   // Constructor for reading, write functionality is static. File should exist, else
   // a OmicsDSException is thrown
-  FileUtility(const std::string& filename, size_t buffer_size = 1024 * 1024 * 8);
+  FileUtility(const std::string& filename, size_t buffer_size = default_buffer_size);
   ~FileUtility();
 
   std::string filename;
@@ -61,6 +63,9 @@ struct FileUtility : public OmicsDSTileDBUtils {
   // returns true if path exists and as a file
   static bool is_file(const std::string& path);
 
+  // returns true if path exists and as a directory
+  static bool is_dir(const std::string& path);
+
   // returns true if path is a workspace
   static bool is_workspace(const std::string& workspace);
 
@@ -74,6 +79,12 @@ struct FileUtility : public OmicsDSTileDBUtils {
   static int write_file(const std::string& filename, const void* buffer, size_t length,
                         const bool overwrite = false);
 
+  // create/delete directories (recursively) and files
+  // returns tiledb return code
+  static int create_dir(const std::string& path);
+  static int delete_dir(const std::string& path);
+  static int delete_file(const std::string& path);
+
   static inline std::string slashify(const std::string& path) {
     if (path.empty()) {
       return "/";
@@ -49,4 +49,40 @@ void OmicsDSImportConfig::merge(const OmicsDSImportConfig& update_config) {
   if (update_config.sample_map) {
     sample_map = *update_config.sample_map;
   }
+  if (update_config.parse_threads) {
+    parse_threads = *update_config.parse_threads;
+  }
+  if (update_config.write_buffer_sets) {
+    write_buffer_sets = *update_config.write_buffer_sets;
+  }
+  if (update_config.memory_budget) {
+    memory_budget = *update_config.memory_budget;
+  }
+  if (update_config.shards) {
+    shards = *update_config.shards;
+  }
+  if (update_config.sort_input) {
+    sort_input = update_config.sort_input;
+  }
+  if (update_config.max_open_files) {
+    max_open_files = *update_config.max_open_files;
+  }
+  if (update_config.merge_fan_in) {
+    merge_fan_in = *update_config.merge_fan_in;
+  }
+  if (update_config.presorted_files) {
+    presorted_files = update_config.presorted_files;
+  }
+  if (update_config.decompression_threads) {
+    decompression_threads = *update_config.decompression_threads;
+  }
+  if (update_config.dense) {
+    dense = update_config.dense;
+  }
+  if (update_config.compression) {
+    compression = *update_config.compression;
+  }
+  if (update_config.append) {
+    append = update_config.append;
+  }
 }
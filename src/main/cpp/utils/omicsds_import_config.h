@@ -33,6 +33,7 @@
 
 #pragma once
 
+#include <cstdint>
 #include <optional>
 #include <string>
 
@@ -50,6 +51,45 @@ struct OmicsDSImportConfig {
   std::optional<std::string> sample_map;
   std::optional<std::string> mapping_file;
   bool sample_major = false;
+  // number of threads parsing input files ahead of the merge, unset or 0 parses serially
+  std::optional<uint32_t> parse_threads;
+  // number of write buffer sets, 2 or more store the buffers on a background thread while the
+  // merge fills the next set, unset or 1 stores them on the importing thread
+  std::optional<uint32_t> write_buffer_sets;
+  // total size in bytes of the write buffers of the import, divided over the attributes by their
+  // bytes per cell. The input buffers of the files open at once are capped by it as well, and end
+  // cells waiting to be merged by a quarter of it before they are spilled to the workspace
+  std::optional<uint64_t> memory_budget;
+  // number of shards of the array imported in parallel into fragments of their own, unset or 1
+  // imports into a single fragment. Position major arrays are only sharded from indexed BAM or
+  // CRAM files
+  std::optional<uint32_t> shards;
+  // sort the cells of every file through runs spilled to the workspace, for files that are not
+  // sorted or are matrices oriented differently than the array. Runs are capped by memory_budget
+  bool sort_input = false;
+  // number of input files that are expected to be open at once, with more files every file is only
+  // opened once the merge reaches its cells and closed at its end. Defaults to 1024
+  std::optional<uint32_t> max_open_files;
+  // merge the files in groups of at most this many files, and the groups in groups, for very wide
+  // file lists. Unset or 0 merges all files at once
+  std::optional<uint32_t> merge_fan_in;
+  // the files of the list are sorted and in order, each file only has cells past the cells of the
+  // files before it. The files are then read one after the other instead of being merged. Sample
+  // major imports of files covering disjoint samples are detected without it
+  bool presorted_files = false;
+  // number of threads decompressing every BAM or CRAM file of a read level import, unset or 0
+  // decompresses on the thread parsing the file
+  std::optional<uint32_t> decompression_threads;
+  // store feature level matrices in a dense array of features by samples instead of a sparse one,
+  // the features are indexed in the array metadata. Requires the features of the files in order
+  bool dense = false;
+  // comma separated name=codec[:level][+delta] entries replacing the default compression of the
+  // attributes of new arrays, with COORDS and OFFSETS for the coordinates and the offsets of
+  // variable length attributes. Codecs are none, gzip, zstd and lz4, see OmicsCompression
+  std::optional<std::string> compression;
+  // add the files to an existing array instead of replacing it, not persisted with the workspace.
+  // Reads and intervals must be of samples that are not in the array yet
+  bool append = false;
 
   /**
    * Update this OmicsDSImportConfig, using set fields in update_config.
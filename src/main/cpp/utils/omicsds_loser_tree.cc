@@ -0,0 +1,92 @@
+/**
+ * @file   omicsds_loser_tree.cc
+ *
+ * @section LICENSE
+ *
+ * The MIT License
+ *
+ * @copyright Copyright (c) 2022 Omics Data Automation, Inc.
+ * @copyright Copyright (c) 2023 dātma, inc™
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * @section DESCRIPTION
+ *
+ * Implementation of the tournament tree used to merge sorted streams of cells
+ */
+
+#include "omicsds_loser_tree.h"
+
+#include <utility>
+
+void OmicsLoserTree::reset(size_t lanes) {
+  m_lanes = lanes;
+  m_winner = 0;
+  m_keys.assign(lanes, {0, 0});
+  m_active.assign(lanes, false);
+  m_losers.assign(lanes, 0);
+}
+
+void OmicsLoserTree::update(const key_t& key) {
+  set_key(m_winner, key);
+  replay(m_winner);
+}
+
+void OmicsLoserTree::exhaust() {
+  set_exhausted(m_winner);
+  replay(m_winner);
+}
+
+size_t OmicsLoserTree::runner_up() const {
+  // the runner up lost its last match against the winner, on the path of the winner to the root
+  size_t runner_up = m_lanes;
+  for (size_t node = (m_winner + m_lanes) / 2; node > 0; node /= 2) {
+    size_t lane = m_losers[node];
+    if (m_active[lane] && (runner_up == m_lanes || less(lane, runner_up))) {
+      runner_up = lane;
+    }
+  }
+  return runner_up;
+}
+
+void OmicsLoserTree::replay(size_t lane) {
+  size_t winner = lane;
+  for (size_t node = (lane + m_lanes) / 2; node > 0; node /= 2) {
+    if (less(m_losers[node], winner)) {
+      std::swap(m_losers[node], winner);
+    }
+  }
+  m_winner = winner;
+}
+
+void OmicsLoserTree::rebuild() {
+  if (m_lanes == 0) return;
+
+  // winners of the matches at every internal node, computed bottom up
+  std::vector<size_t> winners(m_lanes);
+  auto winner_of = [&](size_t node) { return node >= m_lanes ? node - m_lanes : winners[node]; };
+  for (size_t node = m_lanes - 1; node > 0; node--) {
+    size_t l = winner_of(2 * node);
+    size_t r = winner_of(2 * node + 1);
+    if (less(r, l)) std::swap(l, r);
+    winners[node] = l;
+    m_losers[node] = r;
+  }
+  m_winner = m_lanes == 1 ? 0 : winners[1];
+}
@@ -0,0 +1,112 @@
+/**
+ * @file   omicsds_loser_tree.h
+ *
+ * @section LICENSE
+ *
+ * The MIT License
+ *
+ * @copyright Copyright (c) 2022 Omics Data Automation, Inc.
+ * @copyright Copyright (c) 2023 dātma, inc™
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * @section DESCRIPTION
+ *
+ * Header file for the tournament tree used to merge sorted streams of cells
+ */
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Loser tree for k-way merges of cell streams keyed only on their coordinates.
+ *
+ * Every lane holds the coordinates of the cell currently at the head of its stream, payloads stay
+ * wherever the caller keeps them. Internal nodes remember the lane that lost the match played at
+ * that node, so replacing the winner's key only replays the log(k) matches on its path to the root.
+ * Ties on coordinates are broken by lane index, which keeps the merge deterministic.
+ */
+class OmicsLoserTree {
+ public:
+  typedef std::array<int64_t, 2> key_t;
+
+  OmicsLoserTree(size_t lanes = 0) { reset(lanes); }
+
+  /**
+   * Resizes the tree to the given number of lanes, all of them exhausted.
+   */
+  void reset(size_t lanes);
+
+  /**
+   * Replaces the key of the winning lane with the key of its next cell and replays its matches.
+   */
+  void update(const key_t& key);
+
+  /**
+   * Marks the winning lane as exhausted and replays its matches.
+   */
+  void exhaust();
+
+  /**
+   * Replays every match, required after changing keys of lanes other than the winner with
+   * set_key()/set_exhausted(), e.g. when initializing the tree.
+   */
+  void rebuild();
+  void set_key(size_t lane, const key_t& key) {
+    m_keys[lane] = key;
+    m_active[lane] = true;
+  }
+  void set_exhausted(size_t lane) { m_active[lane] = false; }
+
+  bool empty() const { return m_lanes == 0 || !m_active[m_winner]; }
+  size_t size() const { return m_lanes; }
+  // lane holding the smallest key, only meaningful if !empty()
+  size_t top() const { return m_winner; }
+  const key_t& top_key() const { return m_keys[m_winner]; }
+  /**
+   * Lane that would win if the winning lane were exhausted, size() if there is none. The winning
+   * lane can be advanced without replaying its matches while it still sorts before this lane.
+   */
+  size_t runner_up() const;
+  const key_t& key(size_t lane) const { return m_keys[lane]; }
+  bool is_exhausted(size_t lane) const { return !m_active[lane]; }
+
+ private:
+  // exhausted lanes sort after every active lane
+  bool less(size_t l, size_t r) const {
+    if (m_active[l] != m_active[r]) return m_active[l];
+    auto& lk = m_keys[l];
+    auto& rk = m_keys[r];
+    if (lk[0] != rk[0]) return lk[0] < rk[0];
+    if (lk[1] != rk[1]) return lk[1] < rk[1];
+    return l < r;
+  }
+  void replay(size_t lane);
+
+  size_t m_lanes = 0;
+  size_t m_winner = 0;
+  std::vector<key_t> m_keys;
+  std::vector<char> m_active;
+  // m_losers[node] for internal nodes 1..m_lanes-1, leaves are m_lanes..2*m_lanes-1
+  std::vector<size_t> m_losers;
+};
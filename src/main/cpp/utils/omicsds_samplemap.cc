@@ -33,13 +33,14 @@
 
 #include "omicsds_samplemap.h"
 #include "omicsds_file_utils.h"
+#include "omicsds_tokenizer.h"
 
 SampleMap::SampleMap(const std::string& sample_map) {
-  FileUtility file(sample_map);
+  OmicsLineReader lines(std::make_shared<FileUtility>(sample_map));
 
-  std::string line;
-  while (file.generalized_getline(line)) {
-    auto toks = split(line, "\t");
+  std::string_view line;
+  while (lines.next_line(line)) {
+    auto toks = split(std::string(line), "\t");
     if (toks.size() < 2) continue;
     try {
       std::string name = toks[0];
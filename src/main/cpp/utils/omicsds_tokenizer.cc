@@ -0,0 +1,245 @@
+/**
+ * @file   omicsds_tokenizer.cc
+ *
+ * @section LICENSE
+ *
+ * The MIT License
+ *
+ * @copyright Copyright (c) 2022 Omics Data Automation, Inc.
+ * @copyright Copyright (c) 2023 dātma, inc™
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * @section DESCRIPTION
+ *
+ * Implementation of reading and tokenizing delimited text files without copying them
+ */
+
+#include "omicsds_tokenizer.h"
+#include "tiledb_utils.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <charconv>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#if defined(__SSE2__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+const char* find_delimiter(const char* begin, const char* end, char delimiter, char alternative) {
+#if defined(__AVX2__)
+  const __m256i delimiters = _mm256_set1_epi8(delimiter);
+  const __m256i alternatives = _mm256_set1_epi8(alternative);
+  for (; end - begin >= 32; begin += 32) {
+    __m256i chars = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin));
+    uint32_t mask = _mm256_movemask_epi8(_mm256_or_si256(
+        _mm256_cmpeq_epi8(chars, delimiters), _mm256_cmpeq_epi8(chars, alternatives)));
+    if (mask) return begin + __builtin_ctz(mask);
+  }
+#endif
+#if defined(__SSE2__)
+  const __m128i delimiters_16 = _mm_set1_epi8(delimiter);
+  const __m128i alternatives_16 = _mm_set1_epi8(alternative);
+  for (; end - begin >= 16; begin += 16) {
+    __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+    uint32_t mask = _mm_movemask_epi8(
+        _mm_or_si128(_mm_cmpeq_epi8(chars, delimiters_16), _mm_cmpeq_epi8(chars, alternatives_16)));
+    if (mask) return begin + __builtin_ctz(mask);
+  }
+#endif
+  for (; begin < end; begin++) {
+    if (*begin == delimiter || *begin == alternative) return begin;
+  }
+  return end;
+}
+
+bool parse_float(std::string_view token, float& value) {
+  // std::stof skips leading whitespace and accepts a plus sign, std::from_chars does not
+  size_t start = 0;
+  while (start < token.size() && std::isspace(static_cast<unsigned char>(token[start]))) {
+    start++;
+  }
+  if (start < token.size() && token[start] == '+') {
+    start++;
+    if (start < token.size() && token[start] == '-') return false;
+  }
+  const char* begin = token.data() + start;
+  const char* end = token.data() + token.size();
+#if defined(__cpp_lib_to_chars)
+  auto result = std::from_chars(begin, end, value);
+  return result.ec == std::errc() && result.ptr != begin;
+#else
+  // strtof needs a terminated string
+  std::string number(begin, end);
+  char* parsed;
+  errno = 0;
+  value = std::strtof(number.c_str(), &parsed);
+  return parsed != number.c_str() && errno != ERANGE;
+#endif
+}
+
+OmicsLineReader::~OmicsLineReader() {
+  if (m_thread.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_stop = true;
+    }
+    m_chunk_freed.notify_all();
+    m_thread.join();
+  }
+  if (m_mapped) {
+    munmap(m_mapped, m_mapped_size);
+  }
+}
+
+void OmicsLineReader::start() {
+  m_started = true;
+  if (!map()) {
+    m_thread = std::thread(&OmicsLineReader::read_ahead, this);
+  }
+}
+
+bool OmicsLineReader::map() {
+  if (!m_map || TileDBUtils::is_cloud_path(m_file->filename) || !m_file->file_size) {
+    return false;
+  }
+  int fd = open(m_file->filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  void* mapped = mmap(nullptr, m_file->file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapped == MAP_FAILED) {
+    return false;
+  }
+  madvise(mapped, m_file->file_size, MADV_SEQUENTIAL);
+  m_mapped = mapped;
+  m_mapped_size = m_file->file_size;
+  // skip what generalized_getline already returned
+  m_next = static_cast<const char*>(mapped) + m_file->chars_read - m_file->str_buffer.size();
+  m_end = static_cast<const char*>(mapped) + m_mapped_size;
+  return true;
+}
+
+void OmicsLineReader::read_ahead() {
+  // bytes of the file not read yet, including what generalized_getline buffered
+  size_t remaining = m_file->file_size - m_file->chars_read + m_file->str_buffer.size();
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while (remaining) {
+    m_chunk_freed.wait(lock,
+                       [this] { return m_stop || !m_free.empty() || m_created < m_num_chunks; });
+    if (m_stop) break;
+    Chunk chunk;
+    if (m_free.empty()) {
+      m_created++;
+    } else {
+      chunk = std::move(m_free.back());
+      m_free.pop_back();
+    }
+
+    // read outside of the lock
+    lock.unlock();
+    chunk.size = std::min(m_chunk_size, remaining);
+    chunk.data.resize(std::max(chunk.data.size(), chunk.size));
+    std::exception_ptr error;
+    try {
+      m_file->read_file(chunk.data.data(), chunk.size);
+    } catch (...) {
+      error = std::current_exception();
+    }
+    remaining -= chunk.size;
+    lock.lock();
+
+    if (error) {
+      m_error = error;
+      break;
+    }
+    m_read.emplace_back(std::move(chunk));
+    m_chunk_read.notify_one();
+  }
+  m_done = true;
+  m_chunk_read.notify_one();
+}
+
+bool OmicsLineReader::next_chunk() {
+  if (!m_thread.joinable()) {
+    return false;  // mapped
+  }
+  std::unique_lock<std::mutex> lock(m_mutex);
+  if (m_current.data.size()) {
+    m_free.emplace_back(std::move(m_current));
+    m_current = Chunk();
+    m_chunk_freed.notify_one();
+  }
+  m_chunk_read.wait(lock, [this] { return m_done || !m_read.empty(); });
+  if (m_read.empty()) {
+    if (m_error) {
+      std::rethrow_exception(m_error);
+    }
+    return false;
+  }
+  m_current = std::move(m_read.front());
+  m_read.pop_front();
+  m_next = m_current.data.data();
+  m_end = m_next + m_current.size;
+  return true;
+}
+
+bool OmicsLineReader::next_line(std::string_view& line) {
+  if (!m_started) {
+    start();
+  }
+  if (m_line_returned) {
+    m_line.clear();
+    m_line_returned = false;
+  }
+
+  while (true) {
+    if (m_next != m_end) {
+      auto newline = static_cast<const char*>(memchr(m_next, '\n', m_end - m_next));
+      if (newline) {
+        if (m_line.empty()) {
+          line = std::string_view(m_next, newline - m_next);
+        } else {  // the rest of a line that spans chunks
+          m_line.append(m_next, newline - m_next);
+          line = m_line;
+          m_line_returned = true;
+        }
+        m_next = newline + 1;
+        return true;
+      }
+      m_line.append(m_next, m_end - m_next);
+      m_next = m_end;
+    }
+
+    if (!next_chunk()) {
+      line = m_line;
+      m_line_returned = true;
+      return !line.empty();
+    }
+  }
+}
@@ -0,0 +1,167 @@
+/**
+ * @file   omicsds_tokenizer.h
+ *
+ * @section LICENSE
+ *
+ * The MIT License
+ *
+ * @copyright Copyright (c) 2022 Omics Data Automation, Inc.
+ * @copyright Copyright (c) 2023 dātma, inc™
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * @section DESCRIPTION
+ *
+ * Header file for reading and tokenizing delimited text files without copying them
+ */
+
+#pragma once
+
+#include "omicsds_file_utils.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+/**
+ * Returns the first occurrence of delimiter or alternative in [begin, end), end if there is none.
+ *
+ * Compares 16 (SSE2) or 32 (AVX2, with -march supporting it) characters at a time.
+ */
+const char* find_delimiter(const char* begin, const char* end, char delimiter, char alternative);
+
+/**
+ * Splits text into the tokens separated by either of two delimiters, as views into text.
+ *
+ * Tokens are the same as with split() for text not enclosed in brackets, e.g. consecutive
+ * delimiters give empty tokens and empty text gives a single empty token, but nothing is copied.
+ */
+class OmicsTokenizer {
+ public:
+  OmicsTokenizer(std::string_view text, char delimiter, char alternative)
+      : m_next(text.data()),
+        m_end(text.data() + text.size()),
+        m_delimiter(delimiter),
+        m_alternative(alternative) {}
+
+  /**
+   * Sets token to the next token, false once all tokens were returned.
+   */
+  bool next(std::string_view& token) {
+    if (!m_next) return false;
+    const char* delimiter = find_delimiter(m_next, m_end, m_delimiter, m_alternative);
+    token = std::string_view(m_next, delimiter - m_next);
+    m_next = delimiter == m_end ? nullptr : delimiter + 1;
+    return true;
+  }
+
+ private:
+  const char* m_next;  // start of the next token, nullptr after the last one
+  const char* m_end;
+  char m_delimiter;
+  char m_alternative;
+};
+
+/**
+ * Parses the number at the start of token like std::stof, without exceptions or copying the token.
+ *
+ * Leading whitespace and characters after the number are ignored. Returns false if token does not
+ * start with a number or the number is out of the range of float.
+ */
+bool parse_float(std::string_view token, float& value);
+
+/**
+ * Reads the lines of a file as views, instead of copying every line.
+ *
+ * Local files are memory mapped unless map is false. Other files, e.g. on cloud storage, are read
+ * in chunks of chunk_size bytes by a background thread that keeps up to num_chunks chunks ahead of
+ * the lines returned, so parsing does not wait on every read. Only lines that span chunks are
+ * copied.
+ *
+ * Picks up after the lines already read with FileUtility::generalized_getline when next_line is
+ * first called, after which the file should not be read otherwise.
+ */
+class OmicsLineReader {
+ public:
+  OmicsLineReader(std::shared_ptr<FileUtility> file, size_t chunk_size = 1024 * 1024,
+                  size_t num_chunks = 4, bool map = true)
+      : m_file(file),
+        m_chunk_size(std::max<size_t>(chunk_size, 1)),
+        m_num_chunks(std::max<size_t>(num_chunks, 2)),
+        m_map(map) {}
+  ~OmicsLineReader();
+
+  /**
+   * Sets line to the next line without its newline, valid until the next call. Returns false at
+   * the end of the file, a last line lacking a newline is only returned if it is not empty.
+   */
+  bool next_line(std::string_view& line);
+
+  /**
+   * True if the rest of the file was memory mapped, after the first call to next_line.
+   */
+  bool mapped() const { return m_mapped; }
+
+ private:
+  void start();
+  bool map();
+  void read_ahead();
+  // moves on to the next chunk read ahead, false at the end of the file
+  bool next_chunk();
+
+  std::shared_ptr<FileUtility> m_file;
+  size_t m_chunk_size;
+  size_t m_num_chunks;
+  bool m_map;
+  bool m_started = false;
+
+  // unread part of the mapping or of the current chunk
+  const char* m_next = nullptr;
+  const char* m_end = nullptr;
+  // lines spanning chunks are assembled here
+  std::string m_line;
+  bool m_line_returned = false;
+
+  void* m_mapped = nullptr;
+  size_t m_mapped_size = 0;
+
+  struct Chunk {
+    std::vector<char> data;
+    size_t size = 0;
+  };
+  std::deque<Chunk> m_read;   // chunks read ahead, in file order
+  std::vector<Chunk> m_free;  // chunks that can be read into
+  Chunk m_current;            // chunk the unread part is in
+  size_t m_created = 0;       // chunks allocated so far
+  bool m_done = false;        // the whole file was read ahead
+  bool m_stop = false;
+  std::exception_ptr m_error;
+  std::mutex m_mutex;
+  std::condition_variable m_chunk_read;
+  std::condition_variable m_chunk_freed;
+  std::thread m_thread;
+};
@@ -0,0 +1,122 @@
+/**
+ * @file   test_arena.cc
+ *
+ * @section LICENSE
+ *
+ * The MIT License
+ *
+ * @copyright Copyright (c) 2022 Omics Data Automation, Inc.
+ * @copyright Copyright (c) 2023 dātma, inc™
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * @section DESCRIPTION
+ *
+ * Test bump allocator for cell payloads
+ */
+
+
+#include "catch.h"
+
+#include "omicsds_arena.h"
+
+#include <cstring>
+#include <vector>
+
+TEST_CASE("test arena", "[test_arena]") {
+  SECTION("allocations are aligned and do not overlap") {
+    OmicsArena arena(64);
+    std::vector<std::pair<uint8_t*, size_t>> allocations;
+    for (auto i = 1u; i < 40; i++) {
+      uint8_t* ptr = arena.allocate(i);
+      CHECK(reinterpret_cast<uintptr_t>(ptr) % 8 == 0);
+      memset(ptr, i, i);
+      allocations.emplace_back(ptr, i);
+    }
+    for (auto& allocation : allocations) {
+      for (auto j = 0u; j < allocation.second; j++) {
+        REQUIRE(allocation.first[j] == allocation.second);
+      }
+    }
+  }
+
+  SECTION("append copies") {
+    OmicsArena arena;
+    const char* str = "ACGT";
+    uint8_t* ptr = arena.append(str, 4);
+    CHECK(memcmp(ptr, str, 4) == 0);
+    CHECK(ptr != reinterpret_cast<const uint8_t*>(str));
+  }
+
+  SECTION("large allocations get their own block") {
+    OmicsArena arena(64);
+    arena.allocate(8);
+    uint8_t* ptr = arena.allocate(1000);
+    memset(ptr, 1, 1000);
+    CHECK(arena.capacity() >= 1064);
+  }
+
+  SECTION("reset reuses memory") {
+    OmicsArena arena(64);
+    for (auto i = 0u; i < 100; i++) {
+      arena.allocate(16);
+    }
+    size_t capacity = arena.capacity();
+    for (auto round = 0u; round < 10; round++) {
+      arena.reset();
+      for (auto i = 0u; i < 100; i++) {
+        arena.allocate(16);
+      }
+    }
+    CHECK(arena.capacity() == capacity);
+  }
+
+  SECTION("released blocks are recycled") {
+    OmicsArena arena(64);
+    // allocations released in fifo order, like end cells of sorted intervals
+    std::vector<uint32_t> blocks;
+    for (auto i = 0u; i < 1000; i++) {
+      uint32_t block;
+      arena.allocate(24, &block);
+      blocks.push_back(block);
+      if (blocks.size() > 10) {
+        arena.release(blocks.front());
+        blocks.erase(blocks.begin());
+      }
+    }
+    CHECK(arena.capacity() <= 64 * 8);
+  }
+
+  SECTION("live blocks are not recycled") {
+    OmicsArena arena(64);
+    uint32_t block;
+    uint8_t* kept = arena.allocate(8, &block);
+    memset(kept, 7, 8);
+    for (auto i = 0u; i < 100; i++) {
+      uint32_t other;
+      uint8_t* ptr = arena.allocate(32, &other);
+      memset(ptr, 0, 32);
+      arena.release(other);
+    }
+    for (auto j = 0u; j < 8; j++) {
+      REQUIRE(kept[j] == 7);
+    }
+    arena.release(block);
+  }
+}
@@ -0,0 +1,79 @@
+/**
+ * @file   test_compression.cc
+ *
+ * @section LICENSE
+ *
+ * The MIT License
+ *
+ * @copyright Copyright (c) 2022 Omics Data Automation, Inc.
+ * @copyright Copyright (c) 2023 dātma, inc™
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * @section DESCRIPTION
+ *
+ * Test parsing the compression of array attributes
+ */
+
+#include "catch.h"
+
+#include "omicsds_compression.h"
+
+TEST_CASE("test compression", "[test_compression]") {
+  SECTION("codecs") {
+    auto zstd = OmicsCompression::parse("zstd");
+    REQUIRE(zstd);
+    CHECK(*zstd == OmicsCompression(OmicsCompression::ZSTD));
+    CHECK(*OmicsCompression::parse("none") == OmicsCompression());
+    CHECK(*OmicsCompression::parse("gzip:9") == OmicsCompression(OmicsCompression::GZIP, 9));
+    CHECK(*OmicsCompression::parse("lz4+delta") ==
+          OmicsCompression(OmicsCompression::LZ4, 0, true));
+    CHECK(*OmicsCompression::parse("zstd:19+delta") ==
+          OmicsCompression(OmicsCompression::ZSTD, 19, true));
+    CHECK(OmicsCompression::parse("zstd:19+delta")->to_string() == "zstd:19+delta");
+    CHECK(OmicsCompression::parse("lz4")->to_string() == "lz4");
+  }
+
+  SECTION("invalid codecs") {
+    CHECK_FALSE(OmicsCompression::parse(""));
+    CHECK_FALSE(OmicsCompression::parse("snappy"));
+    CHECK_FALSE(OmicsCompression::parse("zstd:"));
+    CHECK_FALSE(OmicsCompression::parse("zstd:0"));
+    CHECK_FALSE(OmicsCompression::parse("zstd:high"));
+    CHECK_FALSE(OmicsCompression::parse("zstd+double-delta"));
+  }
+
+  SECTION("entries") {
+    OmicsCompressionMap compression = {{"SCORE", OmicsCompression(OmicsCompression::LZ4)},
+                                       {"COORDS", OmicsCompression()}};
+    REQUIRE(parse_compression("COORDS=zstd+delta,SEQ=gzip:6", compression));
+    CHECK(compression.size() == 3);
+    CHECK(compression["SCORE"] == OmicsCompression(OmicsCompression::LZ4));
+    CHECK(compression["COORDS"] == OmicsCompression(OmicsCompression::ZSTD, 0, true));
+    CHECK(compression["SEQ"] == OmicsCompression(OmicsCompression::GZIP, 6));
+    REQUIRE(parse_compression("", compression));
+    CHECK(compression.size() == 3);
+
+    // invalid entries leave the compression as it was
+    CHECK_FALSE(parse_compression("SCORE=zstd,SEQ", compression));
+    CHECK_FALSE(parse_compression("SCORE=zstd,=lz4", compression));
+    CHECK_FALSE(parse_compression("SCORE=zstd,SEQ=brotli", compression));
+    CHECK(compression["SCORE"] == OmicsCompression(OmicsCompression::LZ4));
+  }
+}
@@ -0,0 +1,112 @@
+/**
+ * @file   test_loser_tree.cc
+ *
+ * @section LICENSE
+ *
+ * The MIT License
+ *
+ * @copyright Copyright (c) 2022 Omics Data Automation, Inc.
+ * @copyright Copyright (c) 2023 dātma, inc™
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * @section DESCRIPTION
+ *
+ * Test loser tree merge of sorted lanes
+ */
+
+#include "catch.h"
+
+#include "omicsds_loser_tree.h"
+
+#include <algorithm>
+#include <deque>
+#include <tuple>
+
+TEST_CASE("test loser tree", "[test_loser_tree]") {
+  typedef OmicsLoserTree::key_t key_t;
+
+  SECTION("empty tree") {
+    OmicsLoserTree tree;
+    CHECK(tree.empty());
+    tree.reset(3);
+    tree.rebuild();
+    CHECK(tree.empty());
+  }
+
+  SECTION("single lane") {
+    OmicsLoserTree tree(1);
+    tree.set_key(0, {1, 2});
+    tree.rebuild();
+    REQUIRE(!tree.empty());
+    CHECK(tree.top() == 0);
+    CHECK(tree.runner_up() == 1);
+    tree.update({1, 3});
+    CHECK(tree.top_key() == key_t{1, 3});
+    tree.exhaust();
+    CHECK(tree.empty());
+  }
+
+  for (size_t num_lanes : {2u, 3u, 5u, 8u, 13u}) {
+    SECTION("merge " + std::to_string(num_lanes) + " lanes") {
+      // interleaved sorted lanes with duplicate coordinates across lanes and some empty lanes
+      std::vector<std::deque<key_t>> lanes(num_lanes);
+      std::vector<std::tuple<key_t, size_t>> expected;
+      for (size_t lane = 0; lane < num_lanes; lane++) {
+        if (lane % 4 == 3) continue;
+        for (int64_t i = 0; i < 20; i++) {
+          key_t key = {i / 7, (i * 3 + (int64_t)lane) % 11 + (i % 7) * 11};
+          lanes[lane].push_back(key);
+          expected.emplace_back(key, lane);
+        }
+      }
+      std::sort(expected.begin(), expected.end());
+
+      OmicsLoserTree tree(num_lanes);
+      for (size_t lane = 0; lane < num_lanes; lane++) {
+        if (!lanes[lane].empty()) tree.set_key(lane, lanes[lane].front());
+      }
+      tree.rebuild();
+
+      std::vector<std::tuple<key_t, size_t>> merged;
+      while (!tree.empty()) {
+        size_t lane = tree.top();
+        REQUIRE(tree.top_key() == lanes[lane].front());
+        // the runner up holds the smallest head of the other lanes
+        size_t runner_up = num_lanes;
+        for (size_t other = 0; other < num_lanes; other++) {
+          if (other == lane || lanes[other].empty()) continue;
+          if (runner_up == num_lanes || std::tie(lanes[other].front(), other) <
+                                            std::tie(lanes[runner_up].front(), runner_up)) {
+            runner_up = other;
+          }
+        }
+        CHECK(tree.runner_up() == runner_up);
+        merged.emplace_back(tree.top_key(), lane);
+        lanes[lane].pop_front();
+        if (lanes[lane].empty()) {
+          tree.exhaust();
+        } else {
+          tree.update(lanes[lane].front());
+        }
+      }
+      CHECK(merged == expected);
+    }
+  }
+}
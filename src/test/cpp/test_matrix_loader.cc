@@ -36,8 +36,54 @@
 
 #include "omicsds_array_metadata.pb.h"
 #include "omicsds_configure.h"
+#include "omicsds_export.h"
 #include "omicsds_loader.h"
 
+#include <chrono>
+#include <cmath>
+#include <numeric>
+#include <random>
+#include <set>
+
+// splits the sample columns of a matrix file over parts files named prefix followed by the part,
+// and returns their names
+static std::vector<std::string> split_matrix(const std::string& matrix_file, size_t parts,
+                                             const std::string& prefix) {
+  std::vector<std::vector<std::string>> rows;
+  FileUtility reader(matrix_file);
+  std::string line;
+  while (reader.generalized_getline(line)) {
+    rows.push_back(split(line, "\t"));
+  }
+  std::vector<std::string> filenames;
+  size_t columns = rows[0].size() - 1;
+  for (auto part = 0u; part < parts; part++) {
+    std::string matrix;
+    for (auto& row : rows) {
+      matrix += row[0];
+      for (auto column = 1 + columns * part / parts; column < 1 + columns * (part + 1) / parts;
+           column++) {
+        matrix += "\t" + row[column];
+      }
+      matrix += "\n";
+    }
+    filenames.push_back(prefix + std::to_string(part));
+    FileUtility::write_file(filenames.back(), matrix, true);
+  }
+  return filenames;
+}
+
+// matrix with a variable length attribute, whose rows cannot be merged a batch at a time
+class VariableMatrixLoader : public MatrixLoader {
+ public:
+  using MatrixLoader::MatrixLoader;
+  void create_schema() override {
+    MatrixLoader::create_schema();
+    m_schema->attributes.emplace("NAME",
+                                 OmicsFieldInfo(OmicsFieldInfo::OmicsFieldType::omics_char, -1));
+  }
+};
+
 TEST_CASE_METHOD(TempDir, "test MatrixLoader", "[MatrixLoader]") {
   std::string file_list = append("matrix-file-list");
   std::string matrix_file =
@@ -83,6 +129,20 @@ TEST_CASE_METHOD(TempDir, "test MatrixLoader", "[MatrixLoader]") {
     REQUIRE(ml.get_extent(Dimension::FEATURE).second == 281474976954141ul);
   }
 
+  SECTION("test variable length attributes", "[MatrixLoader bulk rows]") {
+    VariableMatrixLoader ml(append("variable-workspace"), "array", file_list, sample_map);
+    REQUIRE_THROWS_AS(ml.initialize(), OmicsDSException);
+  }
+
+  SECTION("test sharded import", "[MatrixLoader import shards]") {
+    // every shard of a matrix would parse all of it, the features are not indexed
+    std::string workspace = append("sharded-import-workspace");
+    MatrixLoader ml = MatrixLoader(workspace, "array", file_list, sample_map);
+    OmicsDSImportConfig import;
+    import.shards = 4;
+    REQUIRE_THROWS_AS(ml.configure(import), OmicsDSException);
+  }
+
   SECTION("test protobuf extents") {
     std::string workspace = append("protobuf-workspace");
     {
@@ -122,3 +182,528 @@ TEST_CASE_METHOD(TempDir, "test MatrixLoader", "[MatrixLoader]") {
     REQUIRE(metadata.get_extent(Dimension::FEATURE).second == 281474976954141ul);
   }
 }
+
+// coords and score of every cell of a matrix array passed by query, in order
+static std::vector<std::pair<std::array<uint64_t, 3>, float>> matrix_cells(
+    const std::string& workspace) {
+  std::vector<std::pair<std::array<uint64_t, 3>, float>> cells;
+  OmicsExporter exporter(workspace, "array");
+  std::array<int64_t, 2> all = {0, std::numeric_limits<int64_t>::max()};
+  exporter.query(all, all,
+                 [&](const std::array<uint64_t, 3>& coords,
+                     const std::vector<OmicsFieldData>& data) {
+                   cells.emplace_back(coords, data[0].get<float>(0));
+                 });
+  return cells;
+}
+
+TEST_CASE_METHOD(TempDir, "test MatrixLoader import options", "[MatrixLoader import options]") {
+  std::string file_list = append("matrix-file-list");
+  std::string matrix_file =
+      std::string(std::string(OMICSDS_TEST_INPUTS) + "OmicsDSTests/test_matrix.sorted");
+  FileUtility::write_file(file_list, matrix_file, true);
+  std::string sample_map = std::string(std::string(OMICSDS_TEST_INPUTS) + "OmicsDSTests/small_map");
+
+  // every option of the import stores the cells of an import without options
+  std::string plain_workspace = append("plain-workspace");
+  {
+    MatrixLoader ml = MatrixLoader(plain_workspace, "array", file_list, sample_map);
+    ml.initialize();
+    ml.import();
+  }
+  auto plain_cells = matrix_cells(plain_workspace);
+  REQUIRE(plain_cells.size() == 2 * 304);
+
+  // imports list into workspace with the options of import and compares the cells of the array with
+  // those of the plain import
+  auto check_import = [&](const std::string& workspace, const std::string& list,
+                          const OmicsDSImportConfig& import) {
+    {
+      MatrixLoader ml = MatrixLoader(workspace, "array", list, sample_map);
+      ml.configure(import);
+      ml.initialize();
+      ml.import();
+    }
+    CHECK(matrix_cells(workspace) == plain_cells);
+  };
+  // splits the matrix over files of its samples or of its features
+  auto split_list = [&](std::vector<std::string> filenames) {
+    std::string list = append("split-file-list"), files;
+    for (auto& filename : filenames) {
+      files += filename + "\n";
+    }
+    FileUtility::write_file(list, files, true);
+    return list;
+  };
+  std::string workspace = append("workspace");
+  OmicsDSImportConfig import;
+
+  SECTION("test parse threads", "[MatrixLoader import options threads]") {
+    import.parse_threads = 4;
+    check_import(workspace, file_list, import);
+  }
+
+  SECTION("test write buffer sets", "[MatrixLoader import options write behind]") {
+    import.parse_threads = 2;
+    import.write_buffer_sets = 3;
+    import.memory_budget = 16 * 1024;  // many small writes
+    check_import(workspace, file_list, import);
+  }
+
+  SECTION("test append", "[MatrixLoader import options append]") {
+    check_import(workspace, file_list, import);
+    auto read_schema = [&workspace] {
+      FileUtility reader(workspace + "/array/omics_schema");
+      std::string schema, line;
+      while (reader.generalized_getline(line)) {
+        schema += line + "\n";
+      }
+      return schema;
+    };
+    std::string schema = read_schema();
+
+    // the cells of the appended fragment replace those at the same coordinates
+    import.append = true;
+    check_import(workspace, file_list, import);
+    REQUIRE(TileDBUtils::get_dirs(workspace + "/array").size() == 2);
+    CHECK(read_schema() == schema);
+    OmicsDSArrayMetadata metadata = OmicsDSArrayMetadata(workspace + "/array/metadata");
+    REQUIRE(metadata.get_extent(Dimension::SAMPLE).second == 303ul);
+    REQUIRE(metadata.get_extent(Dimension::FEATURE).second == 281474976954141ul);
+
+    // reads do not match the schema of the matrix array
+    ReadCountLoader loader(workspace, "array", file_list, sample_map, "", true);
+    loader.configure(import);
+    REQUIRE_THROWS_AS(loader.initialize(), OmicsDSException);
+    REQUIRE(TileDBUtils::get_dirs(workspace + "/array").size() == 2);
+  }
+
+  SECTION("test sort input", "[MatrixLoader import options sort]") {
+    std::string unsorted_list = append("unsorted-file-list");
+    FileUtility::write_file(
+        unsorted_list, std::string(OMICSDS_TEST_INPUTS) + "OmicsDSTests/test_matrix.unsorted",
+        true);
+    import.sort_input = true;
+    import.parse_threads = 2;
+    import.memory_budget = 4 * 1024;  // the runs are spilled to the workspace
+    check_import(workspace, unsorted_list, import);
+    // a single fragment instead of one per unsorted row, and the runs are gone
+    REQUIRE(TileDBUtils::get_dirs(workspace + "/array").size() == 1);
+    REQUIRE(TileDBUtils::get_dirs(workspace).size() == 1);
+  }
+
+  SECTION("test max open files", "[MatrixLoader import options pooled]") {
+    // the samples of the matrix split over two files, which overlap and are opened lazily
+    import.max_open_files = 1;
+    import.parse_threads = 2;
+    check_import(workspace, split_list(split_matrix(matrix_file, 2, append("test_matrix.split"))),
+                 import);
+  }
+
+  SECTION("test merge fan in", "[MatrixLoader import options fan-in]") {
+    // groups of 2 files, groups of 2 groups and the final merge
+    import.merge_fan_in = 2;
+    import.parse_threads = 2;
+    check_import(workspace, split_list(split_matrix(matrix_file, 5, append("test_matrix.split"))),
+                 import);
+    REQUIRE(TileDBUtils::get_dirs(workspace + "/array").size() == 1);
+  }
+
+  SECTION("test presorted files", "[MatrixLoader import options presorted]") {
+    // the features of the matrix split over files in order, which are read one after the other
+    std::vector<std::string> lines;
+    FileUtility reader(matrix_file);
+    std::string line;
+    while (reader.generalized_getline(line)) {
+      lines.push_back(line);
+    }
+    std::vector<std::string> parts;
+    size_t rows = lines.size() - 1;
+    for (auto part = 0u; part < 2; part++) {
+      std::string matrix = lines[0] + "\n";
+      for (auto row = 1 + rows * part / 2; row < 1 + rows * (part + 1) / 2; row++) {
+        matrix += lines[row] + "\n";
+      }
+      parts.push_back(append("test_matrix.part" + std::to_string(part)));
+      FileUtility::write_file(parts.back(), matrix, true);
+    }
+    import.presorted_files = true;
+    import.max_open_files = 1;
+    import.parse_threads = 2;
+    check_import(workspace, split_list(parts), import);
+    REQUIRE(TileDBUtils::get_dirs(workspace + "/array").size() == 1);
+  }
+
+  SECTION("test dense", "[MatrixLoader import options dense]") {
+    // cells are passed with their encoded ids and versions, as those of sparse arrays
+    import.dense = true;
+    import.memory_budget = 1024;  // a block per feature
+    check_import(workspace, file_list, import);
+    REQUIRE(TileDBUtils::get_dirs(workspace + "/array").size() == 2);
+    OmicsDSArrayMetadata metadata = OmicsDSArrayMetadata(workspace + "/array/metadata");
+    REQUIRE(metadata.is_dense());
+    auto features = metadata.dense_features();
+    REQUIRE(features.size() == 2);
+    REQUIRE(features[0].first == 281474976848846ul);
+    REQUIRE(features[1].first == 281474976954141ul);
+
+    // batches hold the same cells as columns, SCORE is the only attribute
+    OmicsExporter exporter(workspace, "array");
+    std::vector<std::pair<std::array<uint64_t, 3>, float>> batch_cells;
+    exporter.query_batches([&](OmicsColumns& columns) {
+      REQUIRE(columns.value_sizes[0] == columns.cells * sizeof(float));
+      auto scores = static_cast<float*>(columns.values[0]);
+      for (size_t cell = 0; cell < columns.cells; cell++) {
+        batch_cells.push_back(
+            {{columns.samples[cell], columns.positions[cell], columns.levels[cell]}, scores[cell]});
+      }
+    });
+    CHECK(batch_cells == plain_cells);
+
+    // dense arrays cannot be appended to
+    MatrixLoader ml = MatrixLoader(workspace, "array", file_list, sample_map);
+    import.append = true;
+    REQUIRE_THROWS_AS(ml.configure(import), OmicsDSException);
+  }
+
+  SECTION("test compression", "[MatrixLoader import options compression]") {
+    MatrixLoader ml = MatrixLoader(append("invalid-workspace"), "array", file_list, sample_map);
+    import.compression = "SCORE=brotli";
+    REQUIRE_THROWS_AS(ml.configure(import), OmicsDSException);
+
+    import.compression = "SCORE=zstd:3,COORDS=gzip+delta";
+    check_import(workspace, file_list, import);
+  }
+}
+
+TEST_CASE("test MatrixReader batches", "[MatrixReader batch]") {
+  std::string matrix_file =
+      std::string(std::string(OMICSDS_TEST_INPUTS) + "OmicsDSTests/test_matrix.sorted");
+  auto sample_map = std::make_shared<SampleMap>(
+      std::string(std::string(OMICSDS_TEST_INPUTS) + "OmicsDSTests/small_map"));
+  auto schema = std::make_shared<OmicsSchema>();
+  schema->order = OmicsSchema::POSITION_MAJOR;
+  schema->attributes.emplace("SCORE",
+                             OmicsFieldInfo(OmicsFieldInfo::OmicsFieldType::omics_float_t, 1));
+
+  MatrixReader batch_reader(matrix_file, schema, sample_map, 0);
+  MatrixReader cell_reader(matrix_file, schema, sample_map, 0);
+
+  CellBatch batch(schema, 100);
+  OmicsArena arena;
+  size_t cells = 0;
+  while (batch_reader.get_next_batch(batch)) {
+    REQUIRE(batch.validate());
+    REQUIRE(batch.size() <= 100);
+    for (auto row = 0u; row < batch.size(); row++, cells++) {
+      auto expected = cell_reader.get_next_cells();
+      REQUIRE(expected.size() == 1);
+      OmicsCell cell = batch.cell(row, 0, arena);
+      CHECK(cell.coords == expected[0].coords);
+      REQUIRE(cell.fields[0].length == sizeof(float));
+      REQUIRE(expected[0].fields[0].length == sizeof(float));
+      CHECK(memcmp(cell.fields[0].data, expected[0].fields[0].data, sizeof(float)) == 0);
+      CHECK(batch.end_positions[row] == -1);
+    }
+  }
+  CHECK(cells == 608);
+  CHECK(cell_reader.get_next_cells().empty());
+}
+
+TEST_CASE("test PooledReader", "[PooledReader]") {
+  std::string matrix_file =
+      std::string(std::string(OMICSDS_TEST_INPUTS) + "OmicsDSTests/test_matrix.sorted");
+  auto sample_map = std::make_shared<SampleMap>(
+      std::string(std::string(OMICSDS_TEST_INPUTS) + "OmicsDSTests/small_map"));
+  auto schema = std::make_shared<OmicsSchema>();
+  schema->order = OmicsSchema::POSITION_MAJOR;
+  schema->attributes.emplace("SCORE",
+                             OmicsFieldInfo(OmicsFieldInfo::OmicsFieldType::omics_float_t, 1));
+
+  auto pool = std::make_shared<OmicsReaderPool>(1);
+  size_t opened = 0;
+  auto open = [&](size_t buffer_size) {
+    opened++;
+    return std::make_shared<MatrixReader>(matrix_file, schema, sample_map, 0, true, buffer_size);
+  };
+  PooledReader pooled_reader(matrix_file, schema, sample_map, 0, open, pool, 4096, false);
+  MatrixReader expected_reader(matrix_file, schema, sample_map, 0);
+  CHECK(pooled_reader.deferred());
+  CHECK(opened == 0);
+
+  CellBatch batch(schema, 100), expected(schema, 100);
+  size_t cells = 0;
+  while (pooled_reader.get_next_batch(batch)) {
+    CHECK(pooled_reader.is_open());
+    REQUIRE(expected_reader.get_next_batch(expected));
+    CHECK(batch.coords == expected.coords);
+    CHECK(batch.data[0] == expected.data[0]);
+    cells += batch.size();
+  }
+  CHECK(cells == 608);
+  // closed at end of file and not reopened
+  CHECK(!pooled_reader.is_open());
+  CHECK(!pooled_reader.deferred());
+  CHECK(!pooled_reader.get_next_batch(batch));
+  CHECK(opened == 1);
+  CHECK(pool->peak_open() == 1);
+}
+
+TEST_CASE_METHOD(TempDir, "test MergingReader", "[MergingReader]") {
+  std::string matrix_file =
+      std::string(std::string(OMICSDS_TEST_INPUTS) + "OmicsDSTests/test_matrix.sorted");
+  auto sample_map = std::make_shared<SampleMap>(
+      std::string(std::string(OMICSDS_TEST_INPUTS) + "OmicsDSTests/small_map"));
+  auto schema = std::make_shared<OmicsSchema>();
+  schema->order = OmicsSchema::POSITION_MAJOR;
+  schema->attributes.emplace("SCORE",
+                             OmicsFieldInfo(OmicsFieldInfo::OmicsFieldType::omics_float_t, 1));
+
+  std::vector<std::shared_ptr<OmicsFileReader>> readers;
+  for (auto& filename : split_matrix(matrix_file, 3, append("test_matrix.split"))) {
+    readers.push_back(std::make_shared<MatrixReader>(filename, schema, sample_map, readers.size()));
+  }
+  MergingReader merging_reader(readers, 16, 0);
+  MatrixReader expected_reader(matrix_file, schema, sample_map, 0);
+
+  CellBatch batch(schema, 100), expected(schema, 100);
+  size_t cells = 0;
+  while (merging_reader.get_next_batch(batch)) {
+    REQUIRE(batch.validate());
+    REQUIRE(expected_reader.get_next_batch(expected));
+    REQUIRE(batch.size() == expected.size());
+    CHECK(batch.coords == expected.coords);
+    CHECK(batch.levels == expected.levels);
+    CHECK(batch.data[0] == expected.data[0]);
+    cells += batch.size();
+  }
+  CHECK(cells == 608);
+  CHECK(!expected_reader.get_next_batch(expected));
+}
+
+TEST_CASE_METHOD(TempDir, "test SortingReader", "[SortingReader]") {
+  std::string inputs = std::string(OMICSDS_TEST_INPUTS) + "OmicsDSTests/";
+  auto sample_map = std::make_shared<SampleMap>(inputs + "small_map");
+  auto schema = std::make_shared<OmicsSchema>();
+  schema->order = OmicsSchema::POSITION_MAJOR;
+  schema->attributes.emplace("SCORE",
+                             OmicsFieldInfo(OmicsFieldInfo::OmicsFieldType::omics_float_t, 1));
+
+  // sample major copy of the sorted matrix
+  std::string transposed = append("test_matrix.transposed");
+  {
+    FileUtility reader(inputs + "test_matrix.sorted");
+    std::vector<std::vector<std::string>> rows;
+    std::string line;
+    while (reader.generalized_getline(line)) {
+      rows.push_back(split(line, "\t"));
+    }
+    std::string matrix = "GENE";
+    for (auto row = 1u; row < rows.size(); row++) {
+      matrix += "\t" + rows[row][0];
+    }
+    for (auto column = 1u; column < rows[0].size(); column++) {
+      matrix += "\n" + rows[0][column];
+      for (auto row = 1u; row < rows.size(); row++) {
+        matrix += "\t" + rows[row][column];
+      }
+    }
+    FileUtility::write_file(transposed, matrix + "\n", true);
+  }
+
+  REQUIRE_THROWS_AS(MatrixReader(transposed, schema, sample_map, 0), OmicsDSException);
+
+  for (auto& filename : {inputs + "test_matrix.unsorted", transposed}) {
+    // runs of a few blocks of 16 cells
+    auto reader = std::make_shared<MatrixReader>(filename, schema, sample_map, 0, false);
+    SortingReader sorting_reader(reader, append("run_"), 1024, 0, 16);
+    MatrixReader sorted_reader(inputs + "test_matrix.sorted", schema, sample_map, 0);
+
+    CellBatch batch(schema, 100), expected(schema, 100);
+    size_t cells = 0;
+    while (sorting_reader.get_next_batch(batch)) {
+      REQUIRE(batch.validate());
+      REQUIRE(sorted_reader.get_next_batch(expected));
+      REQUIRE(batch.size() == expected.size());
+      CHECK(batch.coords == expected.coords);
+      CHECK(batch.levels == expected.levels);
+      CHECK(batch.data[0] == expected.data[0]);
+      cells += batch.size();
+    }
+    CHECK(cells == 608);
+    CHECK(!sorted_reader.get_next_batch(expected));
+    CHECK(sorting_reader.num_runs() > 1);
+    // runs are deleted once merged
+    CHECK(TileDBUtils::get_files(get_temp_dir()).size() == 1);
+  }
+}
+
+TEST_CASE_METHOD(TempDir, "test OmicsEndCellQueue", "[OmicsEndCellQueue]") {
+  auto schema = std::make_shared<OmicsSchema>();
+  schema->order = OmicsSchema::POSITION_MAJOR;
+  schema->attributes.emplace("NAME",
+                             OmicsFieldInfo(OmicsFieldInfo::OmicsFieldType::omics_char, -1));
+  schema->attributes.emplace("SCORE",
+                             OmicsFieldInfo(OmicsFieldInfo::OmicsFieldType::omics_float_t, 1));
+  schema->attributes.emplace("SPAN",
+                             OmicsFieldInfo(OmicsFieldInfo::OmicsFieldType::omics_int64_t, 2));
+
+  // intervals starting in order whose ends are shuffled
+  std::vector<int64_t> ends(1000);
+  std::iota(ends.begin(), ends.end(), 0);
+  std::shuffle(ends.begin(), ends.end(), std::mt19937(0));
+  CellBatch batch(schema, ends.size());
+  for (auto i = 0u; i < ends.size(); i++) {
+    batch.add_cell({0, (int64_t)i}, ends[i]);
+    std::string name = "interval" + std::to_string(ends[i]);
+    batch.append(0, name.data(), name.size());
+    batch.append_value<float>(1, ends[i]);
+    batch.append(schema->slot<int64_t>("SPAN"), std::array<int64_t, 2>{i, ends[i]}.data(), 2);
+  }
+  auto check_top = [](OmicsEndCellQueue& queue, int64_t end) {
+    REQUIRE(!queue.empty());
+    REQUIRE(queue.top_coords() == std::array<int64_t, 2>({end, 0}));
+    OmicsCell cell = queue.top();
+    CHECK(cell.coords == std::array<int64_t, 2>({end, 0}));
+    CHECK(std::string((const char*)cell.fields[0].data, cell.fields[0].length) ==
+          "interval" + std::to_string(end));
+    CHECK(*(const float*)cell.fields[1].data == end);
+    queue.pop();
+  };
+
+  SECTION("spilled end cells") {
+    OmicsEndCellQueue queue;
+    queue.reset(schema, append("end_cells_"), 4 * 1024, 16);
+    for (auto row = 0u; row < batch.size(); row++) {
+      queue.push(batch, row, {batch.end_positions[row], 0});
+    }
+    CHECK(queue.num_runs() > 1);
+    for (auto end = 0; end < (int64_t)ends.size(); end++) {
+      check_top(queue, end);
+    }
+    CHECK(queue.empty());
+    // runs are deleted once merged
+    CHECK(TileDBUtils::get_files(get_temp_dir()).empty());
+  }
+
+  SECTION("compacted end cells") {
+    // the end cells are merged right away, so popped cells are compacted away instead of spilled
+    OmicsEndCellQueue queue;
+    queue.reset(schema, append("end_cells_"), 4 * 1024, 16);
+    std::set<int64_t> queued;
+    for (auto row = 0u; row < batch.size(); row++) {
+      queue.push(batch, row, {batch.end_positions[row], 0});
+      queued.insert(batch.end_positions[row]);
+      if (queued.size() > 8) {
+        check_top(queue, *queued.begin());
+        queued.erase(queued.begin());
+      }
+    }
+    for (auto end : queued) {
+      check_top(queue, end);
+    }
+    CHECK(queue.empty());
+    CHECK(queue.num_runs() == 0);
+  }
+
+  SECTION("end markers") {
+    auto span = schema->slot<int64_t>("SPAN");
+    OmicsEndCellQueue queue;
+    queue.reset(schema, append("end_cells_"), 4 * 1024, 16);
+    for (auto row = 0u; row < batch.size(); row++) {
+      queue.push_marker({batch.end_positions[row], 0}, span, {(int64_t)row, ends[row]});
+    }
+    std::vector<int64_t> starts(ends.size());
+    for (auto i = 0u; i < ends.size(); i++) {
+      starts[ends[i]] = i;
+    }
+    for (auto end = 0; end < (int64_t)ends.size(); end++) {
+      REQUIRE(!queue.empty());
+      OmicsCell cell = queue.top();
+      CHECK(cell.coords == std::array<int64_t, 2>({end, 0}));
+      CHECK(cell.fields[0].length == 0);
+      CHECK(*(const float*)cell.fields[1].data == 0);
+      REQUIRE(cell.fields[2].length == 2 * sizeof(int64_t));
+      CHECK(((const int64_t*)cell.fields[2].data)[0] == starts[end]);
+      CHECK(((const int64_t*)cell.fields[2].data)[1] == end);
+      queue.pop();
+    }
+    CHECK(queue.empty());
+  }
+}
+
+// hidden, run with ctests "[benchmark]"
+TEST_CASE_METHOD(TempDir, "benchmark matrix compression", "[.][benchmark]") {
+  // a matrix of the samples of the test matrix with a row for every gene
+  std::string sample_map = std::string(std::string(OMICSDS_TEST_INPUTS) + "OmicsDSTests/small_map");
+  std::string header;
+  FileUtility(std::string(OMICSDS_TEST_INPUTS) + "OmicsDSTests/test_matrix.sorted")
+      .generalized_getline(header);
+  size_t samples = split(header, "\t").size() - 1;
+  std::string matrix = header + "\n";
+  std::mt19937 generator(17);
+  std::lognormal_distribution<float> expression(1.0f, 1.5f);
+  for (int gene = 0; gene < 18000; gene++) {
+    char id[32];
+    snprintf(id, sizeof(id), "ENSG%011d", 1000 + gene * 7);
+    matrix += id;
+    for (auto sample = 0u; sample < samples; sample++) {
+      matrix += "\t" + std::to_string(std::round(expression(generator) * 100) / 100);
+    }
+    matrix += "\n";
+  }
+  std::string matrix_file = append("benchmark.matrix");
+  FileUtility::write_file(matrix_file, matrix, true);
+  std::string file_list = append("benchmark-file-list");
+  FileUtility::write_file(file_list, matrix_file, true);
+
+  std::function<size_t(const std::string&)> footprint = [&](const std::string& dir) {
+    size_t bytes = 0;
+    for (auto& file : TileDBUtils::get_files(dir)) {
+      bytes += std::max<ssize_t>(TileDBUtils::file_size(file), 0);
+    }
+    for (auto& subdir : TileDBUtils::get_dirs(dir)) {
+      bytes += footprint(subdir);
+    }
+    return bytes;
+  };
+  auto ms = [](auto duration) {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(duration).count();
+  };
+
+  std::cout << "Matrix of " << samples << " samples by 18000 genes, " << matrix.size()
+            << " bytes" << std::endl;
+  for (std::string compression :
+       {"SCORE=none,COORDS=none,OFFSETS=none", "", "SCORE=zstd,COORDS=zstd:9+delta"}) {
+    std::string workspace = append("benchmark-workspace");
+    {
+      MatrixLoader ml = MatrixLoader(workspace, "array", file_list, sample_map);
+      OmicsDSImportConfig import;
+      import.compression = compression;
+      ml.configure(import);
+      ml.initialize();
+      ml.import();
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    size_t cells = 0;
+    OmicsExporter exporter(workspace, "array");
+    exporter.query({0, std::numeric_limits<int64_t>::max()},
+                   {0, std::numeric_limits<int64_t>::max()},
+                   [&cells](const std::array<uint64_t, 3>&, const std::vector<OmicsFieldData>&) {
+                     cells++;
+                   });
+    auto scan_time = std::chrono::steady_clock::now() - start;
+
+    start = std::chrono::steady_clock::now();
+    size_t batch_cells = 0;
+    exporter.query_batches([&batch_cells](OmicsColumns& columns) { batch_cells += columns.cells; });
+    auto batch_scan_time = std::chrono::steady_clock::now() - start;
+    CHECK(batch_cells == cells);
+
+    std::cout << (compression.empty() ? "default compression" : compression) << ": "
+              << footprint(workspace + "/array") << " bytes, scanned " << cells << " cells in "
+              << ms(scan_time) << "ms, " << ms(batch_scan_time) << "ms in batches" << std::endl;
+    TileDBUtils::delete_dir(workspace);
+  }
+}
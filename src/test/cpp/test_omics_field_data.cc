@@ -108,3 +108,41 @@ TEST_CASE("test OmicsFieldData class", "[omicsfielddata]") {
     }
   }
 }
+
+TEST_CASE("test FieldSlot", "[fieldslot]") {
+  OmicsSchema schema;
+  schema.attributes.emplace("POS",
+                            OmicsFieldInfo(OmicsFieldInfo::OmicsFieldType::omics_int32_t, 1));
+  schema.attributes.emplace("CIGAR",
+                            OmicsFieldInfo(OmicsFieldInfo::OmicsFieldType::omics_uint32_t, -1));
+  schema.attributes.emplace("SEQ", OmicsFieldInfo(OmicsFieldInfo::OmicsFieldType::omics_char, -1));
+
+  auto pos = schema.slot<int32_t>("POS");
+  auto cigar = schema.slot<uint32_t>("CIGAR");
+  auto seq = schema.slot<char>("SEQ");
+  auto missing = schema.slot<float>("SCORE");
+
+  REQUIRE(pos.valid());
+  REQUIRE(cigar.valid());
+  REQUIRE(seq.valid());
+  REQUIRE(!missing.valid());
+  CHECK(pos.idx == schema.index_of_attribute("POS"));
+  CHECK(cigar.idx == schema.index_of_attribute("CIGAR"));
+  CHECK(seq.idx == schema.index_of_attribute("SEQ"));
+
+  std::vector<OmicsFieldData> data(schema.attributes.size());
+  data[pos.idx].push_back(int32_t(42));
+  uint32_t cigar_ops[] = {10 << 4, 5 << 4 | 1};
+  data[cigar.idx].push_pointer_back(cigar_ops, 2);
+  data[seq.idx].push_pointer_back("ACGT", 4);
+
+  CHECK(pos.get(data) == 42);
+  CHECK(cigar.size(data) == 2);
+  CHECK(cigar.get(data, 1) == (5 << 4 | 1));
+  CHECK(std::string(seq.ptr(data), seq.size(data)) == "ACGT");
+
+  CHECK(schema.attributes.at("POS").holds<int32_t>());
+  CHECK(!schema.attributes.at("POS").holds<uint32_t>());
+  CHECK(schema.attributes.at("SEQ").holds<char>());
+  CHECK(!schema.attributes.at("SEQ").holds<int8_t>());
+}
@@ -28,8 +28,11 @@
 #include "catch.h"
 #include "test_base.h"
 
+#include "omicsds_export.h"
 #include "omicsds_loader.h"
 
+#include <set>
+
 TEST_CASE("test generic SAM reader", "[test_basic]") {
   read_sam_file(std::string(OMICSDS_TEST_INPUTS) + "empty.sam");
 }
@@ -39,3 +42,423 @@ TEST_CASE_METHOD(TempDir, "test using temp dir", "[test_temp_dir]") {
   std::string workspace_path = append("workspace");
   REQUIRE(!TileDBUtils::workspace_exists(workspace_path));
 }
+
+TEST_CASE("test GenomicMap", "[test_genomic_map]") {
+  // contigs start at the offsets in the third column of the fai
+  GenomicMap map(std::string(OMICSDS_TEST_INPUTS) + "OmicsDSTests/human_g1k_v37.fasta.fai");
+  auto contigs = map.contig_boundaries();
+  REQUIRE(contigs.size() > 3);
+  CHECK(contigs[0] == 52);
+  CHECK(contigs[1] == 253404903);
+  CHECK(map.flatten("2", 100) == 253405003);
+  CHECK(map.unflatten(253405003) == std::make_pair(std::string("2"), (uint64_t)100));
+  CHECK(map.unflatten(52) == std::make_pair(std::string("1"), (uint64_t)0));
+  CHECK(map.unflatten(52 + 249250620) == std::make_pair(std::string("1"), (uint64_t)249250620));
+}
+
+// coords and fields of every cell of the array passed by query, in order
+static std::vector<std::pair<std::array<uint64_t, 3>, std::vector<OmicsFieldData>>> query_cells(
+    const std::string& workspace, const std::string& array) {
+  std::vector<std::pair<std::array<uint64_t, 3>, std::vector<OmicsFieldData>>> cells;
+  OmicsExporter exporter(workspace, array);
+  std::array<int64_t, 2> all = {0, std::numeric_limits<int64_t>::max()};
+  exporter.query(all, all,
+                 [&](const std::array<uint64_t, 3>& coords,
+                     const std::vector<OmicsFieldData>& data) {
+                   cells.emplace_back(coords, data);
+                 });
+  return cells;
+}
+
+// slot of attribute name in the schema of workspace/array
+template <class T>
+static FieldSlot<T> array_slot(const std::string& workspace, const std::string& array,
+                               const std::string& name) {
+  OmicsSchema schema;
+  schema.create_from_file(FileUtility::append(workspace, array, "omics_schema"));
+  return schema.slot<T>(name);
+}
+
+static std::string field_string(const FieldSlot<char>& slot,
+                                const std::vector<OmicsFieldData>& data) {
+  return std::string(slot.ptr(data), slot.size(data));
+}
+
+static bool operator==(const OmicsFieldData& a, const OmicsFieldData& b) {
+  return a.data == b.data;
+}
+
+TEST_CASE_METHOD(TempDir, "test ReadCountLoader", "[ReadCountLoader]") {
+  std::string inputs = std::string(OMICSDS_TEST_INPUTS) + "OmicsDSTests/";
+  std::string file_list = append("sam_list");
+  FileUtility::write_file(file_list, inputs + "toy.sam\n" + inputs + "toy2.sam\n", true);
+  std::string sample_map = inputs + "sam_map";
+  std::string mapping_file = inputs + "human_g1k_v37.fasta.fai";
+
+  SECTION("test sharded import", "[ReadCountLoader import shards]") {
+    // position major shards of unindexed files would all parse every file
+    ReadCountLoader position_major(append("position-major"), "array", file_list, sample_map,
+                                   mapping_file, true);
+    OmicsDSImportConfig import;
+    import.shards = 2;
+    REQUIRE_THROWS_AS(position_major.configure(import), OmicsDSException);
+
+    // sample major shards only read the files of their samples
+    std::string workspace = append("sample-major");
+    {
+      ReadCountLoader plain(workspace, "plain", file_list, sample_map, mapping_file, false);
+      plain.initialize();
+      plain.import();
+    }
+    {
+      ReadCountLoader sharded(workspace, "sharded", file_list, sample_map, mapping_file, false);
+      sharded.configure(import);
+      sharded.initialize();
+      sharded.import();
+    }
+    auto cells = query_cells(workspace, "plain");
+    REQUIRE(cells.size() == 18);
+    CHECK(query_cells(workspace, "sharded") == cells);
+  }
+
+  SECTION("test sharded indexed import", "[ReadCountLoader import shards index]") {
+    // the positions of contig 1 are split at 600 between two shards. The alignment of long at 550
+    // ends in the first shard, its template ends at 649 in the second
+    std::string small_map = append("small.fai");
+    FileUtility::write_file(small_map, std::string("1\t1000\t100\t60\t61\n"), true);
+    std::string sam = append("reads.sam"), bam = append("reads.bam");
+    FileUtility::write_file(sam,
+                            std::string("@SQ\tSN:1\tLN:1000\n"
+                                        "short\t0\t1\t100\t30\t10M\t*\t0\t0\tACGTACGTAC\t*\n"
+                                        "long\t99\t1\t450\t30\t10M\t=\t540\t100\tACGTACGTAC\t*\n"
+                                        "long\t147\t1\t540\t30\t10M\t=\t450\t-100\tACGTACGTAC\t*\n"
+                                        "late\t0\t1\t700\t30\t10M\t*\t0\t0\tACGTACGTAC\t*\n"),
+                            true);
+    samFile* in = sam_open(sam.c_str(), "r");
+    REQUIRE(in);
+    sam_hdr_t* hdr = sam_hdr_read(in);
+    samFile* out = sam_open(bam.c_str(), "wb");
+    REQUIRE(sam_hdr_write(out, hdr) == 0);
+    bam1_t* align = bam_init1();
+    while (sam_read1(in, hdr, align) >= 0) {
+      REQUIRE(sam_write1(out, hdr, align) >= 0);
+    }
+    bam_destroy1(align);
+    sam_close(out);
+    sam_hdr_destroy(hdr);
+    sam_close(in);
+    REQUIRE(sam_index_build(bam.c_str(), 0) == 0);
+    FileUtility::write_file(append("bam_list"), bam + "\n", true);
+    FileUtility::write_file(append("bam_map"), std::string("reads.bam\t0\n"), true);
+
+    std::string workspace = append("indexed");
+    {
+      ReadCountLoader plain(workspace, "plain", append("bam_list"), append("bam_map"), small_map,
+                            true);
+      plain.initialize();
+      plain.import();
+    }
+    {
+      ReadCountLoader sharded(workspace, "sharded", append("bam_list"), append("bam_map"),
+                              small_map, true);
+      OmicsDSImportConfig import;
+      import.shards = 2;
+      sharded.configure(import);
+      sharded.initialize();
+      sharded.import();
+    }
+    auto cells = query_cells(workspace, "plain");
+    REQUIRE(cells.size() == 4);
+    CHECK(query_cells(workspace, "sharded") == cells);
+
+    // long at 450 is passed by its end cell in the second shard
+    auto qname = array_slot<char>(workspace, "plain", "QNAME");
+    auto pos = array_slot<int32_t>(workspace, "plain", "POS");
+    for (auto array : {"plain", "sharded"}) {
+      std::vector<std::pair<std::string, int32_t>> reads;
+      OmicsExporter exporter(workspace, array);
+      exporter.query({0, 0}, {620, 700},
+                     [&](const std::array<uint64_t, 3>& coords,
+                         const std::vector<OmicsFieldData>& data) {
+                       reads.emplace_back(field_string(qname, data), pos.get(data));
+                     });
+      CHECK(reads == std::vector<std::pair<std::string, int32_t>>{{"long", 540}, {"long", 450}});
+    }
+  }
+
+  SECTION("test append", "[ReadCountLoader import append]") {
+    // the levels of reads at the same coordinates are numbered by their import, so appends only add
+    // other samples
+    std::string workspace = append("append");
+    std::string toy_list = append("toy_list"), toy2_list = append("toy2_list");
+    FileUtility::write_file(toy_list, inputs + "toy.sam\n", true);
+    FileUtility::write_file(toy2_list, inputs + "toy2.sam\n", true);
+    {
+      ReadCountLoader loader(workspace, "array", toy_list, sample_map, mapping_file, true);
+      loader.initialize();
+      loader.import();
+    }
+    REQUIRE(query_cells(workspace, "array").size() == 12);
+
+    OmicsDSImportConfig import;
+    import.append = true;
+    {
+      ReadCountLoader loader(workspace, "array", toy2_list, sample_map, mapping_file, true);
+      loader.configure(import);
+      loader.initialize();
+      loader.import();
+    }
+    CHECK(query_cells(workspace, "array").size() == 18);
+    CHECK(OmicsDSArrayMetadata(workspace + "/array/metadata").sample_rows() ==
+          std::vector<uint64_t>{0, 1});
+
+    ReadCountLoader loader(workspace, "array", toy_list, sample_map, mapping_file, true);
+    loader.configure(import);
+    REQUIRE_THROWS_AS(loader.initialize(), OmicsDSException);
+  }
+
+  SECTION("test query", "[ReadCountLoader query]") {
+    std::string workspace = append("query");
+    {
+      ReadCountLoader loader(workspace, "array", file_list, sample_map, mapping_file, true);
+      loader.initialize();
+      loader.import();
+    }
+    auto qname = array_slot<char>(workspace, "array", "QNAME");
+    auto pos = array_slot<int32_t>(workspace, "array", "POS");
+    OmicsExporter exporter(workspace, "array");
+    std::vector<std::pair<std::string, int32_t>> reads;
+    auto collect = [&](const std::array<uint64_t, 3>& coords,
+                       const std::vector<OmicsFieldData>& data) {
+      reads.emplace_back(field_string(qname, data), pos.get(data));
+    };
+
+    // contig 1 starts at 52, r001 at 7 spans 59-97 and is passed after the reads that start in
+    // range. r001 at 37 spans 89-127
+    exporter.query({0, 0}, {60, 100}, collect);
+    CHECK(reads == std::vector<std::pair<std::string, int32_t>>{{"r002", 9},
+                                                                {"r003", 10},
+                                                                {"r004", 16},
+                                                                {"r003", 29},
+                                                                {"r001", 37},
+                                                                {"r001", 7}});
+
+    // reads without a template length start and end at the same position, x1 at 1 of contig 2
+    reads.clear();
+    exporter.query({0, 0}, {253404904, 253404904}, collect);
+    CHECK(reads == std::vector<std::pair<std::string, int32_t>>{{"x1", 1}});
+
+    // every read is passed once
+    reads.clear();
+    exporter.query({0, 1}, {0, std::numeric_limits<int64_t>::max()}, collect);
+    CHECK(reads.size() == 18);
+    CHECK(std::set<std::pair<std::string, int32_t>>(reads.begin(), reads.end()).size() == 18);
+  }
+
+  SECTION("test read fields", "[ReadCountLoader read fields]") {
+    // names, sequences and qualities of toy.sam in the order of their positions. Sequences are
+    // decoded to upper case, a missing QUAL is kept as *
+    std::vector<std::array<std::string, 3>> expected = {
+        {"r001", "TTAGATAAAGAGGATACTG", "*"},
+        {"r002", "AAAAGATAAGGGATAAA", "*"},
+        {"r003", "AGCTAA", "*"},
+        {"r004", "ATAGCTCTCAGC", "*"},
+        {"r003", "TAGGC", "*"},
+        {"r001", "CAGCGCCAT", "*"},
+        {"x1", "AGGTTTTATAAAACAAATAA", std::string(20, '?')},
+        {"x2", "GGTTTTATAAAACAAATAATT", std::string(21, '?')},
+        {"x3", "TTATAAAACAAATAATTAAGTCTACA", std::string(26, '?')},
+        {"x4", "CAAATAATTAAGTCTACAGAGCAAC", std::string(25, '?')},
+        {"x5", "AATAATTAAGTCTACAGAGCAACT", std::string(24, '?')},
+        {"x6", "TAATTAAGTCTACAGAGCAACTA", std::string(23, '?')}};
+    std::string toy_list = append("toy_list");
+    FileUtility::write_file(toy_list, inputs + "toy.sam\n", true);
+    std::string workspace = append("fields");
+    {
+      ReadCountLoader loader(workspace, "array", toy_list, sample_map, mapping_file, true);
+      loader.initialize();
+      loader.import();
+    }
+    auto qname = array_slot<char>(workspace, "array", "QNAME");
+    auto seq = array_slot<char>(workspace, "array", "SEQ");
+    auto qual = array_slot<char>(workspace, "array", "QUAL");
+    std::vector<std::array<std::string, 3>> reads;
+    OmicsExporter exporter(workspace, "array");
+    exporter.query({0, 0}, {0, std::numeric_limits<int64_t>::max()},
+                   [&](const std::array<uint64_t, 3>& coords,
+                       const std::vector<OmicsFieldData>& data) {
+                     reads.push_back({field_string(qname, data), field_string(seq, data),
+                                      field_string(qual, data)});
+                   });
+    CHECK(reads == expected);
+
+    // exported SAM files have the same columns
+    SamExporter sam_exporter(workspace, "array");
+    sam_exporter.export_sams({0, 0}, {0, std::numeric_limits<int64_t>::max()}, append("out"));
+    FileUtility output(append("out0.sam"));
+    std::string line;
+    reads.clear();
+    while (output.generalized_getline(line)) {
+      auto columns = split(line, "\t");
+      REQUIRE(columns.size() == 11);
+      reads.push_back({columns[0], columns[9], columns[10]});
+    }
+    CHECK(reads == expected);
+  }
+}
+
+TEST_CASE_METHOD(TempDir, "test TranscriptomicsLoader", "[TranscriptomicsLoader]") {
+  std::string inputs = std::string(OMICSDS_TEST_INPUTS) + "OmicsDSTests/";
+  std::string file_list = append("small_list");
+  FileUtility::write_file(file_list, inputs + "s0.bed\n" + inputs + "s1.bed\n", true);
+  std::string workspace = append("workspace");
+  {
+    TranscriptomicsLoader loader(workspace, "array", file_list, inputs + "small_map",
+                                 inputs + "human_g1k_v37.fasta.fai", "", true);
+    loader.initialize();
+    loader.import();
+  }
+  auto name = array_slot<char>(workspace, "array", "NAME");
+  auto sample_name = array_slot<char>(workspace, "array", "SAMPLE_NAME");
+  OmicsExporter exporter(workspace, "array");
+  std::vector<std::string> intervals;
+  auto collect = [&](const std::array<uint64_t, 3>& coords,
+                     const std::vector<OmicsFieldData>& data) {
+    intervals.push_back(field_string(sample_name, data) + " " + field_string(name, data));
+  };
+  std::array<int64_t, 2> samples = {304, 305};  // Sample0 and Sample1
+
+  SECTION("test query", "[TranscriptomicsLoader query]") {
+    // contig 1 starts at 52. Line1 of Sample0 spans 57-157 and Line2 157-251, Line1 of Sample1
+    // 62-151 and Line2 152-251. Intervals that start before the range and end in it come last
+    exporter.query(samples, {152, 157}, collect);
+    CHECK(intervals ==
+          std::vector<std::string>{"Sample1 Line2", "Sample0 Line2", "Sample0 Line1"});
+
+    // the end of Line1 and the start of Line2 of Sample0 share a position
+    intervals.clear();
+    exporter.query(samples, {157, 157}, collect);
+    CHECK(intervals == std::vector<std::string>{"Sample0 Line2", "Sample0 Line1"});
+  }
+
+  SECTION("test query passes every interval once", "[TranscriptomicsLoader query once]") {
+    exporter.query(samples, {0, std::numeric_limits<int64_t>::max()}, collect);
+    CHECK(intervals.size() == 7);
+    CHECK(std::set<std::string>(intervals.begin(), intervals.end()).size() == 7);
+  }
+
+  SECTION("test sample major sharded import", "[TranscriptomicsLoader import shards]") {
+    // the samples of bed files are named in their header, the shards probe them before reading
+    std::string sample_major = append("sample-major");
+    {
+      TranscriptomicsLoader loader(sample_major, "plain", file_list, inputs + "small_map",
+                                   inputs + "human_g1k_v37.fasta.fai", "", false);
+      loader.initialize();
+      loader.import();
+    }
+    {
+      TranscriptomicsLoader loader(sample_major, "sharded", file_list, inputs + "small_map",
+                                   inputs + "human_g1k_v37.fasta.fai", "", false);
+      OmicsDSImportConfig import;
+      import.shards = 4;
+      loader.configure(import);
+      loader.initialize();
+      loader.import();
+    }
+    auto cells = query_cells(sample_major, "plain");
+    REQUIRE(cells.size() == 7);
+    CHECK(query_cells(sample_major, "sharded") == cells);
+  }
+}
+
+TEST_CASE_METHOD(TempDir, "test array layout", "[test_array_layout]") {
+  std::string inputs = std::string(OMICSDS_TEST_INPUTS) + "OmicsDSTests/";
+  std::string mapping_file = inputs + "human_g1k_v37.fasta.fai";
+
+  SECTION("test planned layout", "[test_array_layout plan]") {
+    std::string file_list = append("sam_list");
+    FileUtility::write_file(file_list, inputs + "toy.sam\n", true);
+    int64_t end = GenomicMap(mapping_file).contig_boundaries().back();
+    int64_t samples = std::numeric_limits<int32_t>::max();
+
+    ReadCountLoader position_major(append("workspace"), "position_major", file_list,
+                                   inputs + "sam_map", mapping_file, true);
+    position_major.initialize();
+    auto layout = position_major.plan_layout();
+    CHECK(!layout.dense);
+    CHECK(layout.domain == std::array<int64_t, 6>{0, end, 0, samples, 0, INT16_MAX});
+    // 251 bytes per cell, with 16 elements for every variable length attribute
+    CHECK(layout.capacity == 4096);
+
+    ReadCountLoader sample_major(append("workspace"), "sample_major", file_list,
+                                 inputs + "sam_map", mapping_file, false);
+    sample_major.initialize();
+    layout = sample_major.plan_layout();
+    CHECK(layout.domain == std::array<int64_t, 6>{0, samples, 0, end, 0, INT16_MAX});
+    CHECK(layout.capacity == 4096);
+  }
+
+  SECTION("test queries kept within domain", "[test_array_layout within_domain]") {
+    std::array<int64_t, 6> domain = {0, 100, 0, 10, 0, 5};
+    std::vector<int64_t> bounds;
+    std::array<int64_t, 6> all = {0, INT64_MAX, 0, INT64_MAX, 0, INT64_MAX};
+    REQUIRE(OmicsDSArrayStorage::within_domain(domain.data(), 3, all.data(), bounds));
+    CHECK(bounds == std::vector<int64_t>(domain.begin(), domain.end()));
+    std::array<int64_t, 6> part = {50, 200, -5, 3, 1, 1};
+    REQUIRE(OmicsDSArrayStorage::within_domain(domain.data(), 3, part.data(), bounds));
+    CHECK(bounds == std::vector<int64_t>{50, 100, 0, 3, 1, 1});
+    std::array<int64_t, 6> past = {101, 200, 0, 10, 0, 5};
+    CHECK(!OmicsDSArrayStorage::within_domain(domain.data(), 3, past.data(), bounds));
+    std::array<int64_t, 4> before = {0, 100, -10, -1};
+    CHECK(!OmicsDSArrayStorage::within_domain(domain.data(), 2, before.data(), bounds));
+  }
+
+  SECTION("test ends clamped to their contig", "[test_array_layout contig ends]") {
+    // the domain ends with the last contig, reads and intervals that run past the end of their
+    // contig end with it
+    std::string small_map = append("small.fai");
+    FileUtility::write_file(small_map, std::string("1\t45\t52\t60\t61\n2\t40\t200\t60\t61\n"),
+                            true);
+    std::string workspace = append("workspace");
+
+    std::string sam = append("long.sam");
+    FileUtility::write_file(sam,
+                            std::string("@SQ\tSN:1\tLN:45\n@SQ\tSN:2\tLN:40\n"
+                                        "long\t0\t2\t30\t30\t6M\t=\t30\t30\tACGTAC\t*\n"),
+                            true);
+    FileUtility::write_file(append("sam_list"), sam + "\n", true);
+    FileUtility::write_file(append("sam_map"), std::string("long.sam\t0\n"), true);
+    {
+      ReadCountLoader loader(workspace, "reads", append("sam_list"), append("sam_map"), small_map,
+                             true);
+      loader.initialize();
+      loader.import();
+    }
+    auto read_span = array_slot<int64_t>(workspace, "reads", "SPAN");
+    auto reads = query_cells(workspace, "reads");
+    REQUIRE(reads.size() == 1);
+    CHECK(read_span.get(reads[0].second, 0) == 230);
+    CHECK(read_span.get(reads[0].second, 1) == 240);
+
+    std::string bed = append("long.bed");
+    FileUtility::write_file(bed,
+                            std::string("track name=long description=\"Sample0\"\n"
+                                        "1\t10\t20\tshort\t0.5\n"
+                                        "2\t30\t60\tlong\t0.5\n"),
+                            true);
+    FileUtility::write_file(append("bed_list"), bed + "\n", true);
+    FileUtility::write_file(append("bed_map"), std::string("Sample0\t0\n"), true);
+    {
+      TranscriptomicsLoader loader(workspace, "intervals", append("bed_list"), append("bed_map"),
+                                   small_map, "", true);
+      loader.initialize();
+      loader.import();
+    }
+    auto interval_span = array_slot<int64_t>(workspace, "intervals", "SPAN");
+    auto intervals = query_cells(workspace, "intervals");
+    REQUIRE(intervals.size() == 2);
+    CHECK(interval_span.get(intervals[0].second, 1) == 72);
+    CHECK(interval_span.get(intervals[1].second, 0) == 230);
+    CHECK(interval_span.get(intervals[1].second, 1) == 239);
+  }
+}
@@ -0,0 +1,188 @@
+/**
+ * @file   test_tokenizer.cc
+ *
+ * @section LICENSE
+ *
+ * The MIT License
+ *
+ * @copyright Copyright (c) 2022 Omics Data Automation, Inc.
+ * @copyright Copyright (c) 2023 dātma, inc™
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * @section DESCRIPTION
+ * Test tokenizing and reading lines of delimited text files without copying them
+ */
+
+#include "catch.h"
+#include "test_base.h"
+
+#include "omicsds_tokenizer.h"
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+static std::vector<std::string> tokenize(const std::string& text) {
+  std::vector<std::string> tokens;
+  OmicsTokenizer tokenizer(text, '\t', ',');
+  std::string_view token;
+  while (tokenizer.next(token)) {
+    tokens.emplace_back(token);
+  }
+  return tokens;
+}
+
+TEST_CASE("test tokenizer", "[test_tokenizer]") {
+  SECTION("find delimiter") {
+    std::string text(100, 'a');
+    CHECK(find_delimiter(text.data(), text.data() + text.size(), '\t', ',') ==
+          text.data() + text.size());
+    for (size_t pos : {0u, 1u, 15u, 16u, 31u, 32u, 33u, 63u, 99u}) {
+      text[pos] = pos % 2 ? '\t' : ',';
+      CHECK(find_delimiter(text.data(), text.data() + text.size(), '\t', ',') == text.data() + pos);
+      CHECK(find_delimiter(text.data() + pos + 1, text.data() + text.size(), '\t', ',') ==
+            text.data() + text.size());
+      text[pos] = 'a';
+    }
+  }
+
+  SECTION("same tokens as split") {
+    std::string long_line;
+    for (int i = 0; i < 50; i++) {
+      long_line += "token" + std::to_string(i) + (i % 3 ? "\t" : ",");
+    }
+    for (std::string text : {"", "a", "\t", "a\tb,c", "a\t\tb", ",a,", "GENE\tENSG1.1\tENSG2",
+                             "0.5\t1e-3\t-2\t\t", long_line.c_str()}) {
+      CHECK(tokenize(text) == split(text, "\t,"));
+    }
+  }
+
+  SECTION("parse float") {
+    float value;
+    CHECK(parse_float("1.5", value));
+    CHECK(value == 1.5f);
+    CHECK(parse_float(" -2.25", value));
+    CHECK(value == -2.25f);
+    CHECK(parse_float("+3", value));
+    CHECK(value == 3.0f);
+    CHECK(parse_float("1e-3\r", value));
+    CHECK(value == std::stof("1e-3"));
+    CHECK(parse_float("0.1", value));
+    CHECK(value == std::stof("0.1"));
+    CHECK_FALSE(parse_float("", value));
+    CHECK_FALSE(parse_float("abc", value));
+    CHECK_FALSE(parse_float("+-1", value));
+    CHECK_FALSE(parse_float("1e50", value));
+  }
+}
+
+TEST_CASE_METHOD(TempDir, "test line reader", "[test_tokenizer]") {
+  std::string filename = append("lines.txt");
+  std::string content;
+  for (int i = 0; i < 100; i++) {
+    content += "line" + std::to_string(i) + std::string(i % 7 * 10, 'x') + (i % 10 ? "\n" : "\n\n");
+  }
+  content += "last line without newline";
+  FileUtility::write_file(filename, content);
+
+  for (bool map : {true, false}) {
+    for (size_t chunk_size : {1u, 7u, 64u, 1024u * 1024u}) {
+      auto expected = std::make_shared<FileUtility>(filename, 16);
+      auto file = std::make_shared<FileUtility>(filename, 16);
+
+      // the line reader picks up after lines read with generalized_getline
+      std::string header;
+      REQUIRE(expected->generalized_getline(header));
+      REQUIRE(file->generalized_getline(header));
+      CHECK(header == "line0");
+
+      OmicsLineReader lines(file, chunk_size, 2, map);
+      std::string expected_line;
+      std::string_view line;
+      while (expected->generalized_getline(expected_line)) {
+        REQUIRE(lines.next_line(line));
+        CHECK(line == expected_line);
+      }
+      CHECK_FALSE(lines.next_line(line));
+      CHECK(lines.mapped() == map);
+    }
+  }
+
+  SECTION("stop reading ahead") {
+    OmicsLineReader lines(std::make_shared<FileUtility>(filename), 8, 2, false);
+    std::string_view line;
+    REQUIRE(lines.next_line(line));
+    CHECK(line == "line0");
+  }
+
+  SECTION("empty file") {
+    std::string empty = append("empty.txt");
+    FileUtility::write_file(empty, "");
+    for (bool map : {true, false}) {
+      OmicsLineReader lines(std::make_shared<FileUtility>(empty), 8, 2, map);
+      std::string_view line;
+      CHECK_FALSE(lines.next_line(line));
+    }
+  }
+}
+
+// hidden, run with ctests "[benchmark]"
+TEST_CASE("benchmark matrix line parsing", "[.][benchmark]") {
+  // a row of a matrix with a column for every gene
+  std::string line = "SAMPLE1";
+  for (int i = 0; i < 18000; i++) {
+    line += "\t" + std::to_string(i * 0.37f);
+  }
+  const int iterations = 100;
+
+  auto start = std::chrono::steady_clock::now();
+  std::vector<float> split_scores;
+  for (int i = 0; i < iterations; i++) {
+    split_scores.clear();
+    auto toks = split(line, "\t,");
+    for (size_t j = 1; j < toks.size(); j++) {
+      split_scores.push_back(std::stof(toks[j]));
+    }
+  }
+  auto split_time = std::chrono::steady_clock::now() - start;
+
+  start = std::chrono::steady_clock::now();
+  std::vector<float> scores;
+  for (int i = 0; i < iterations; i++) {
+    scores.clear();
+    OmicsTokenizer tokenizer(line, '\t', ',');
+    std::string_view token;
+    tokenizer.next(token);
+    float score;
+    while (tokenizer.next(token) && parse_float(token, score)) {
+      scores.push_back(score);
+    }
+  }
+  auto tokenizer_time = std::chrono::steady_clock::now() - start;
+
+  auto ms = [](auto duration) {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(duration).count();
+  };
+  std::cout << "Parsed " << iterations << " lines of " << split_scores.size()
+            << " scores, split and stof took " << ms(split_time) << "ms, tokenizer took "
+            << ms(tokenizer_time) << "ms" << std::endl;
+  REQUIRE(scores == split_scores);
+}
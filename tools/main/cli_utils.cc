@@ -36,7 +36,9 @@
 #include "omicsds_logger.h"
 #include "omicsds_samplemap.h"
 
+#include <cctype>
 #include <iostream>
+#include <limits>
 #include <string>
 
 ACTION get_action(int argc, char* argv[]) {
@@ -171,6 +173,56 @@ void MatrixFileProcessor::process(const std::string& feature_id, uint64_t sample
   }
 }
 
+// Returns the unsigned value of the option at key, logging and ignoring values that do not parse
+static std::optional<uint32_t> get_unsigned_option(const std::map<char, std::string_view>& opt_map,
+                                                   const char key) {
+  std::string_view value;
+  if (!get_option(opt_map, key, value)) {
+    return std::nullopt;
+  }
+  try {
+    size_t end;
+    auto number = std::stoul(std::string(value), &end);
+    if (end == value.length() && number <= std::numeric_limits<uint32_t>::max()) {
+      return std::make_optional<uint32_t>(number);
+    }
+  } catch (...) {
+  }
+  logger.warn("Ignoring option --{}={}, expected a non-negative integer", OPTION_MAP.at(key).name,
+              value);
+  return std::nullopt;
+}
+
+// Returns the size in bytes of the option at key, which may have a K, M or G suffix for multiples
+// of 1024, logging and ignoring values that do not parse
+static std::optional<uint64_t> get_size_option(const std::map<char, std::string_view>& opt_map,
+                                               const char key) {
+  std::string_view value;
+  if (!get_option(opt_map, key, value)) {
+    return std::nullopt;
+  }
+  try {
+    size_t end;
+    uint64_t number = std::stoull(std::string(value), &end);
+    int shift = 0;
+    if (end + 1 == value.length()) {
+      auto suffix = std::string_view("KMG").find(std::toupper(value[end]));
+      if (suffix != std::string_view::npos) {
+        shift = 10 * (suffix + 1);
+        end++;
+      }
+    }
+    if (end == value.length() && value[0] != '-' &&
+        number <= std::numeric_limits<uint64_t>::max() >> shift) {
+      return std::make_optional<uint64_t>(number << shift);
+    }
+  } catch (...) {
+  }
+  logger.warn("Ignoring option --{}={}, expected a size in bytes with an optional K, M or G suffix",
+              OPTION_MAP.at(key).name, value);
+  return std::nullopt;
+}
+
 OmicsDSImportConfig generate_import_config(const std::map<char, std::string_view>& opt_map) {
   OmicsDSImportConfig import_config;
   if (opt_map.count(FEATURE_LEVEL) == 1) {
@@ -196,5 +248,27 @@ OmicsDSImportConfig generate_import_config(const std::map<char, std::string_view
   if (opt_map.count(SAMPLE_MAJOR) == 1) {
     import_config.sample_major = true;
   }
+  if (opt_map.count(APPEND) == 1) {
+    import_config.append = true;
+  }
+  if (opt_map.count(SORT_INPUT) == 1) {
+    import_config.sort_input = true;
+  }
+  if (opt_map.count(PRESORTED_FILES) == 1) {
+    import_config.presorted_files = true;
+  }
+  if (opt_map.count(DENSE) == 1) {
+    import_config.dense = true;
+  }
+  if (opt_map.count(COMPRESSION) == 1) {
+    import_config.compression = std::make_optional<std::string>(opt_map.at(COMPRESSION));
+  }
+  import_config.parse_threads = get_unsigned_option(opt_map, PARSE_THREADS);
+  import_config.write_buffer_sets = get_unsigned_option(opt_map, WRITE_BUFFER_SETS);
+  import_config.memory_budget = get_size_option(opt_map, MEMORY_BUDGET);
+  import_config.shards = get_unsigned_option(opt_map, SHARDS);
+  import_config.max_open_files = get_unsigned_option(opt_map, MAX_OPEN_FILES);
+  import_config.merge_fan_in = get_unsigned_option(opt_map, MERGE_FAN_IN);
+  import_config.decompression_threads = get_unsigned_option(opt_map, DECOMPRESSION_THREADS);
   return import_config;
 }
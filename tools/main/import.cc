@@ -40,7 +40,7 @@ void print_import_usage() {
                "\e[1m--read-level|--interval-level|--feature-level\e[0m should "
                "be specified for import\n"
             << "\t \e[1m--read-level\e[0m, \e[1m-r\e[0m Option to ingest read "
-               "level related data (file list should contain SAM files)\n"
+               "level related data (file list should contain SAM, BAM or\n\t\t\tCRAM files)\n"
             << "\t \e[1m--interval-level\e[0m, \e[1m-i\e[0m Option to ingest "
                "interval level data (file list should contain Bed files)\n"
             << "\t \e[1m--feature-level\e[0m, \e[1m-f\e[0m Option to ingest "
@@ -58,7 +58,51 @@ void print_import_usage() {
                "starting index separated by tabs). Not needed for ingesting "
                "feature-level data\n"
             << "\t \e[1m--consolidate\e[0m, \e[1m-c\e[0m If provided, the array will be "
-               "consolidated after import.\n";
+               "consolidated after import.\n"
+            << "\t \e[1m--parse-threads\e[0m, \e[1m-t\e[0m Number of threads parsing the "
+               "input files ahead of the merge.\n\t\t\tDefaults to parsing on the importing "
+               "thread.\n"
+            << "\t \e[1m--write-buffer-sets\e[0m, \e[1m-b\e[0m Number of write buffer sets, 2 or "
+               "more write to the array on a\n\t\t\tbackground thread while the next set is "
+               "filled. Defaults to 1.\n"
+            << "\t \e[1m--memory-budget\e[0m, \e[1m-M\e[0m Total size of the write buffers, "
+               "e.g. 512M or 2G.\n\t\t\tAlso caps the input buffers of the files open at once, "
+               "and a quarter of it\n\t\t\tthe end cells of intervals and reads waiting to be "
+               "merged. Defaults to 64M.\n"
+            << "\t \e[1m--shards\e[0m, \e[1m-n\e[0m Number of position (or sample with "
+               "--sample-major) ranges imported in\n\t\t\tparallel into fragments of their own, "
+               "see --consolidate. Position ranges\n\t\t\trequire indexed BAM or CRAM files. "
+               "Defaults to 1.\n"
+            << "\t \e[1m--append\e[0m, \e[1m-A\e[0m If provided, the files are added to the "
+               "existing array as new fragments\n\t\t\tinstead of replacing the workspace. "
+               "They must match the schema of the array. Reads and\n\t\t\tintervals must be "
+               "of samples that are not in the array yet, matrix cells\n\t\t\tat existing "
+               "coordinates replace those.\n"
+            << "\t \e[1m--sort-input\e[0m, \e[1m-S\e[0m If provided, the files are sorted "
+               "before the import, in runs of at most\n\t\t\tthe memory budget spilled to the "
+               "workspace. Required for files that are not sorted\n\t\t\tand for matrix files "
+               "that are not oriented like the array.\n"
+            << "\t \e[1m--max-open-files\e[0m, \e[1m-O\e[0m With more input files, every file "
+               "is only opened once the\n\t\t\tmerge reaches it and closed at its end. "
+               "Defaults to 1024.\n"
+            << "\t \e[1m--merge-fan-in\e[0m, \e[1m-F\e[0m Merge the files in groups of at "
+               "most this many files,\n\t\t\tand the groups in groups, for very wide file "
+               "lists. Defaults to merging all\n\t\t\tfiles at once.\n"
+            << "\t \e[1m--presorted-files\e[0m, \e[1m-P\e[0m If provided, the files of the "
+               "list are in order and do\n\t\t\tnot overlap, and are read one after the other "
+               "instead of being\n\t\t\tmerged.\n"
+            << "\t \e[1m--decompression-threads\e[0m, \e[1m-d\e[0m Number of threads "
+               "decompressing every BAM or CRAM\n\t\t\tfile of a read level import. Defaults "
+               "to decompressing on the thread\n\t\t\tparsing the file.\n"
+            << "\t \e[1m--dense\e[0m, \e[1m-D\e[0m If provided, a feature level import is "
+               "stored as a dense array of\n\t\t\tfeatures by samples. The features of the files "
+               "must be in order, see\n\t\t\t--sort-input. Cannot be appended to.\n"
+            << "\t \e[1m--compression\e[0m, \e[1m-z\e[0m Compression of the attributes of a "
+               "new array, as comma\n\t\t\tseparated name=codec[:level][+delta] entries with "
+               "codecs none, gzip,\n\t\t\tzstd or lz4, e.g. SEQ=zstd:9,COORDS=zstd+delta. "
+               "COORDS and OFFSETS\n\t\t\tname the coordinates and the offsets of variable "
+               "length attributes.\n\t\t\tDefaults to lz4 for attributes, zstd for the "
+               "fields of reads\n\t\t\tand zstd+delta for coordinates and offsets.\n";
 }
 
 int import_main(int argc, char* argv[], LongOptions long_options) {
@@ -74,9 +74,23 @@ const char FILE_LIST = 'l';
 const char MAPPING_FILE = 'm';
 const char SAMPLE_MAJOR = 'p';
 const char CONSOLIDATE_IMPORT = 'c';
-static const std::array<const char, 7> IMPORT_OPTIONS = {
-    READ_LEVEL,   INTERVAL_LEVEL, FEATURE_LEVEL,      FILE_LIST,
-    MAPPING_FILE, SAMPLE_MAJOR,   CONSOLIDATE_IMPORT,
+const char PARSE_THREADS = 't';
+const char WRITE_BUFFER_SETS = 'b';
+const char MEMORY_BUDGET = 'M';
+const char SHARDS = 'n';
+const char APPEND = 'A';
+const char SORT_INPUT = 'S';
+const char MAX_OPEN_FILES = 'O';
+const char MERGE_FAN_IN = 'F';
+const char PRESORTED_FILES = 'P';
+const char DECOMPRESSION_THREADS = 'd';
+const char DENSE = 'D';
+const char COMPRESSION = 'z';
+static const std::array<const char, 19> IMPORT_OPTIONS = {
+    READ_LEVEL,      INTERVAL_LEVEL,        FEATURE_LEVEL, FILE_LIST,         MAPPING_FILE,
+    SAMPLE_MAJOR,    CONSOLIDATE_IMPORT,    PARSE_THREADS, WRITE_BUFFER_SETS, MEMORY_BUDGET,
+    SHARDS,          APPEND,                SORT_INPUT,    MAX_OPEN_FILES,    MERGE_FAN_IN,
+    PRESORTED_FILES, DECOMPRESSION_THREADS, DENSE,         COMPRESSION,
 };
 
 /* Query options */
@@ -101,6 +115,19 @@ static const std::map<char, option> OPTION_MAP = {
     {MAPPING_FILE, {"mapping-file", required_argument, NULL, MAPPING_FILE}},
     {SAMPLE_MAJOR, {"sample-major", no_argument, NULL, SAMPLE_MAJOR}},
     {CONSOLIDATE_IMPORT, {"consolidate", no_argument, NULL, CONSOLIDATE_IMPORT}},
+    {PARSE_THREADS, {"parse-threads", required_argument, NULL, PARSE_THREADS}},
+    {WRITE_BUFFER_SETS, {"write-buffer-sets", required_argument, NULL, WRITE_BUFFER_SETS}},
+    {MEMORY_BUDGET, {"memory-budget", required_argument, NULL, MEMORY_BUDGET}},
+    {SHARDS, {"shards", required_argument, NULL, SHARDS}},
+    {APPEND, {"append", no_argument, NULL, APPEND}},
+    {SORT_INPUT, {"sort-input", no_argument, NULL, SORT_INPUT}},
+    {MAX_OPEN_FILES, {"max-open-files", required_argument, NULL, MAX_OPEN_FILES}},
+    {MERGE_FAN_IN, {"merge-fan-in", required_argument, NULL, MERGE_FAN_IN}},
+    {PRESORTED_FILES, {"presorted-files", no_argument, NULL, PRESORTED_FILES}},
+    {DECOMPRESSION_THREADS,
+     {"decompression-threads", required_argument, NULL, DECOMPRESSION_THREADS}},
+    {DENSE, {"dense", no_argument, NULL, DENSE}},
+    {COMPRESSION, {"compression", required_argument, NULL, COMPRESSION}},
     {GENERIC, {"generic", no_argument, NULL, GENERIC}},
     {EXPORT_MATRIX, {"export-matrix", no_argument, NULL, EXPORT_MATRIX}},
     {EXPORT_SAM, {"export-sam", no_argument, NULL, EXPORT_SAM}}};
@@ -43,6 +43,18 @@ TEST_CASE("test import config", "[cli import]") {
     REQUIRE(!config.mapping_file.has_value());
     REQUIRE(!config.sample_major);
     REQUIRE(!config.sample_map.has_value());
+    REQUIRE(!config.parse_threads.has_value());
+    REQUIRE(!config.write_buffer_sets.has_value());
+    REQUIRE(!config.memory_budget.has_value());
+    REQUIRE(!config.shards.has_value());
+    REQUIRE(!config.append);
+    REQUIRE(!config.sort_input);
+    REQUIRE(!config.max_open_files.has_value());
+    REQUIRE(!config.merge_fan_in.has_value());
+    REQUIRE(!config.presorted_files);
+    REQUIRE(!config.decompression_threads.has_value());
+    REQUIRE(!config.dense);
+    REQUIRE(!config.compression.has_value());
   }
   SECTION("Full map") {
     std::string_view file_list = "my-file-list";
@@ -52,12 +64,54 @@ TEST_CASE("test import config", "[cli import]") {
                                             {FEATURE_LEVEL, ""},
                                             {MAPPING_FILE, mapping_file},
                                             {SAMPLE_MAP, sample_map},
-                                            {SAMPLE_MAJOR, ""}};
+                                            {SAMPLE_MAJOR, ""},
+                                            {PARSE_THREADS, "4"},
+                                            {WRITE_BUFFER_SETS, "3"},
+                                            {MEMORY_BUDGET, "512M"},
+                                            {SHARDS, "8"},
+                                            {APPEND, ""},
+                                            {SORT_INPUT, ""},
+                                            {MAX_OPEN_FILES, "256"},
+                                            {MERGE_FAN_IN, "64"},
+                                            {PRESORTED_FILES, ""},
+                                            {DECOMPRESSION_THREADS, "2"},
+                                            {DENSE, ""},
+                                            {COMPRESSION, "SCORE=zstd:3"}};
     OmicsDSImportConfig config = generate_import_config(map);
     REQUIRE((config.file_list && *config.file_list == file_list));
     REQUIRE((config.import_type && *config.import_type == OmicsDSImportType::FEATURE_IMPORT));
     REQUIRE((config.mapping_file && *config.mapping_file == mapping_file));
     REQUIRE(config.sample_major);
     REQUIRE((config.sample_map && *config.sample_map == sample_map));
+    REQUIRE((config.parse_threads && *config.parse_threads == 4));
+    REQUIRE((config.write_buffer_sets && *config.write_buffer_sets == 3));
+    REQUIRE((config.memory_budget && *config.memory_budget == 512ul * 1024 * 1024));
+    REQUIRE((config.shards && *config.shards == 8));
+    REQUIRE(config.append);
+    REQUIRE(config.sort_input);
+    REQUIRE((config.max_open_files && *config.max_open_files == 256));
+    REQUIRE((config.merge_fan_in && *config.merge_fan_in == 64));
+    REQUIRE(config.presorted_files);
+    REQUIRE((config.decompression_threads && *config.decompression_threads == 2));
+    REQUIRE(config.dense);
+    REQUIRE((config.compression && *config.compression == "SCORE=zstd:3"));
+  }
+  SECTION("Invalid parse threads") {
+    std::map<char, std::string_view> map = {{PARSE_THREADS, "four"}};
+    OmicsDSImportConfig config = generate_import_config(map);
+    REQUIRE(!config.parse_threads.has_value());
+  }
+  SECTION("Memory budget sizes") {
+    auto budget = [](std::string_view value) {
+      std::map<char, std::string_view> map = {{MEMORY_BUDGET, value}};
+      return generate_import_config(map).memory_budget;
+    };
+    REQUIRE(budget("1000") == 1000ul);
+    REQUIRE(budget("64k") == 64ul * 1024);
+    REQUIRE(budget("2G") == 2ul * 1024 * 1024 * 1024);
+    REQUIRE(!budget("").has_value());
+    REQUIRE(!budget("-1").has_value());
+    REQUIRE(!budget("12MB").has_value());
+    REQUIRE(!budget("M").has_value());
   }
 }